@@ -0,0 +1,97 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "drawBenchmark.h"
+
+DrawBenchmark::DrawBenchmark(unsigned int objectCount)
+: renderer(Coordinates(1280, 800)),
+  objectClass("bench", "card", &this->missingPackages),
+  localClient("local", Color(1.0f, 0.0f, 0.0f), 0),
+  otherClient("other", Color(0.0f, 0.0f, 1.0f), 1),
+  markerCount(0) {
+	// The objects are in the drawing order, which keeps the textures together
+	for (unsigned int i = 0; i < objectCount; ++i) {
+		const unsigned int texture = i * TEXTURE_COUNT / objectCount;
+		const Vector2 location((i % 100) * 20.0f, (i / 100) * 30.0f);
+
+		Object *object = new Object(&this->objectClass, "card" + utils::toString(texture), i, location);
+		object->initForClient(&this->renderer);
+
+		if (i % 10 == 0) {
+			object->select(&this->otherClient);
+			++this->markerCount;
+		}
+
+		// The objects in the hand of the local player are drawn face up
+		if (i % 7 == 0) {
+			object->setOwner(&this->localClient);
+			++this->markerCount;
+		}
+
+		this->objects.push_back(object);
+	}
+}
+
+DrawBenchmark::~DrawBenchmark() {
+	for (auto &object : this->objects) {
+		delete object;
+	}
+}
+
+int DrawBenchmark::run() {
+	std::cout << "Drawing " << this->objects.size() << " objects " << FRAMES << " times." << std::endl;
+
+	const double start = utils::getTime();
+	for (unsigned int frame = 0; frame < FRAMES; ++frame) {
+		this->drawFrame();
+	}
+	const double time = utils::getTime() - start;
+
+	std::cout << std::fixed << std::setprecision(3)
+	          << "Draw: " << time * 1000.0 / FRAMES << " ms per frame" << std::endl;
+
+	// The statistics are of the last frame
+	const HeadlessRenderer::Statistics &statistics = this->renderer.getStatistics();
+	const unsigned int textures = std::min(static_cast<unsigned int>(this->objects.size()), TEXTURE_COUNT);
+
+	bool expected = this->check("bitmaps", statistics.bitmaps, this->objects.size());
+	expected = this->check("batches", statistics.batches, textures) && expected;
+	expected = this->check("primitives", statistics.primitives, 0) && expected;
+	expected = this->check("overlay primitives", statistics.overlayPrimitives, this->markerCount) && expected;
+	expected = this->check("overlay passes", statistics.overlayPasses, this->markerCount > 0 ? 1 : 0) && expected;
+
+	return expected ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+void DrawBenchmark::drawFrame() {
+	this->renderer.clear();
+
+	for (auto &object : this->objects) {
+		object->draw(&this->renderer, &this->localClient);
+	}
+
+	this->renderer.drawOverlay();
+}
+
+bool DrawBenchmark::check(const char *name, unsigned int value, unsigned int expected) {
+	if (value != expected) {
+		std::cout << "Error: " << value << " " << name << " drawn instead of " << expected << "." << std::endl;
+		return false;
+	}
+
+	return true;
+}
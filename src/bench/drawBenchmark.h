@@ -0,0 +1,62 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DRAWBENCHMARK_H
+#define DRAWBENCHMARK_H
+
+#include <set>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+#include "../utils.h"
+#include "../vector2.h"
+#include "../color.h"
+#include "../client.h"
+#include "../object.h"
+#include "../objectClass.h"
+#include "../client/headlessRenderer.h"
+
+// Draws a table of objects through the headless renderer the way the client
+// draws its game and checks that the objects of a texture are drawn in one
+// batch and all the markers in one overlay pass.
+class DrawBenchmark {
+public:
+	DrawBenchmark(unsigned int objectCount);
+	~DrawBenchmark(void);
+
+	int run(void);
+
+private:
+	static const unsigned int TEXTURE_COUNT = 8;
+	static const unsigned int FRAMES = 100;
+
+	HeadlessRenderer renderer;
+	std::set<std::string> missingPackages;
+	ObjectClass objectClass;
+	Client localClient;
+	Client otherClient;
+	std::vector<Object*> objects;
+
+	unsigned int markerCount;
+
+	void drawFrame(void);
+	bool check(const char *name, unsigned int value, unsigned int expected);
+};
+
+#endif
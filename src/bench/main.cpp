@@ -0,0 +1,171 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "main.h"
+
+// The boxes are spread over an area about the size of a game table
+const float AREA_SIZE = 2000.0f;
+const float MIN_HALF_SIZE = 5.0f;
+const float MAX_HALF_SIZE = 50.0f;
+const float MAX_SELECTION_SIZE = 500.0f;
+
+int main(int argc, char **argv) {
+	// Get the number of boxes, queries and drawn objects from command line arguments
+	unsigned int boxCount = 10000;
+	unsigned int queryCount = 1000;
+	unsigned int objectCount = 5000;
+
+	if (argc >= 2) {
+		std::istringstream boxString(argv[1]);
+		boxString >> boxCount;
+	}
+
+	if (argc >= 3) {
+		std::istringstream queryString(argv[2]);
+		queryString >> queryCount;
+	}
+
+	if (argc >= 4) {
+		std::istringstream objectString(argv[3]);
+		objectString >> objectCount;
+	}
+
+	BoxBenchmark boxBenchmark(boxCount, queryCount);
+	const int boxResult = boxBenchmark.run();
+
+	DrawBenchmark drawBenchmark(objectCount);
+	const int drawResult = drawBenchmark.run();
+
+	return boxResult == EXIT_SUCCESS && drawResult == EXIT_SUCCESS ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+BoxBenchmark::BoxBenchmark(unsigned int boxCount, unsigned int queryCount)
+: random(1) {
+	this->boxes.reserve(boxCount);
+
+	for (unsigned int i = 0; i < boxCount; ++i) {
+		this->boxes.add(this->randomLocation(), this->randomHalfSize(), this->randomAxis());
+	}
+
+	std::uniform_real_distribution<float> selectionSize(0.0f, MAX_SELECTION_SIZE);
+
+	for (unsigned int i = 0; i < queryCount; ++i) {
+		Query query;
+		query.center = this->randomLocation();
+		query.halfSize = this->randomHalfSize();
+		query.axis = this->randomAxis();
+
+		// Start some of the queries from other than the first box to cover the
+		// boxes left over from the groups of four
+		query.first = i % 4 == 0 ? 0 : i % 7;
+
+		query.min = this->randomLocation();
+		query.max = query.min + Vector2(selectionSize(this->random), selectionSize(this->random));
+
+		this->queries.push_back(query);
+	}
+}
+
+int BoxBenchmark::run() {
+#if !defined __SSE2__
+	std::cout << "Built without SSE2, both of the versions are scalar." << std::endl;
+#endif
+
+	std::cout << "Querying " << this->boxes.size() << " boxes " << this->queries.size() << " times." << std::endl;
+
+	std::vector<size_t> vectorized;
+	std::vector<size_t> scalar;
+	bool agree = true;
+
+	// Overlaps
+	double start = utils::getTime();
+	for (auto &query : this->queries) {
+		this->boxes.queryOverlaps(query.center, query.halfSize, query.axis, query.first, vectorized);
+	}
+	const double overlapsTime = utils::getTime() - start;
+
+	start = utils::getTime();
+	for (auto &query : this->queries) {
+		this->boxes.queryOverlapsScalar(query.center, query.halfSize, query.axis, query.first, scalar);
+	}
+	const double overlapsScalarTime = utils::getTime() - start;
+
+	agree = this->compare("Overlaps", vectorized, overlapsTime, scalar, overlapsScalarTime) && agree;
+
+	vectorized.clear();
+	scalar.clear();
+
+	// Containment
+	start = utils::getTime();
+	for (auto &query : this->queries) {
+		this->boxes.queryContained(query.min, query.max, vectorized);
+	}
+	const double containedTime = utils::getTime() - start;
+
+	start = utils::getTime();
+	for (auto &query : this->queries) {
+		this->boxes.queryContainedScalar(query.min, query.max, scalar);
+	}
+	const double containedScalarTime = utils::getTime() - start;
+
+	agree = this->compare("Contained", vectorized, containedTime, scalar, containedScalarTime) && agree;
+
+	return agree ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+Vector2 BoxBenchmark::randomLocation() {
+	std::uniform_real_distribution<float> coordinate(0.0f, AREA_SIZE);
+
+	const float x = coordinate(this->random);
+	return Vector2(x, coordinate(this->random));
+}
+
+Vector2 BoxBenchmark::randomHalfSize() {
+	std::uniform_real_distribution<float> halfSize(MIN_HALF_SIZE, MAX_HALF_SIZE);
+
+	const float x = halfSize(this->random);
+	return Vector2(x, halfSize(this->random));
+}
+
+Vector2 BoxBenchmark::randomAxis() {
+	std::uniform_real_distribution<float> angle(0.0f, 2.0f * utils::PI);
+
+	const float rotation = angle(this->random);
+	return Vector2(std::cos(rotation), std::sin(rotation));
+}
+
+// Print the timings of a query and whether both versions found the same boxes
+bool BoxBenchmark::compare(const char *name, const std::vector<size_t> &vectorized, double vectorizedTime,
+                           const std::vector<size_t> &scalar, double scalarTime) {
+	std::cout << std::fixed << std::setprecision(3)
+	          << name << ": " << vectorized.size() << " boxes found, SSE " << vectorizedTime * 1000.0 << " ms, scalar "
+	          << scalarTime * 1000.0 << " ms";
+
+	if (vectorizedTime > 0.0) {
+		std::cout << ", " << std::setprecision(2) << scalarTime / vectorizedTime << "x";
+	}
+
+	std::cout << std::endl;
+
+	if (vectorized != scalar) {
+		std::cout << "Error: " << name << " found different boxes with SSE (" << vectorized.size()
+		          << ") and without it (" << scalar.size() << ")." << std::endl;
+		return false;
+	}
+
+	return true;
+}
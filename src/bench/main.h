@@ -0,0 +1,66 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MAIN_H
+#define MAIN_H
+
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+#include "../vector2.h"
+#include "../utils.h"
+#include "../boxArray.h"
+#include "drawBenchmark.h"
+
+int main(int argc, char **argv);
+
+// Runs the SSE and the scalar box queries on the same random boxes, checks
+// that they find the same boxes and reports how long each of them took.
+class BoxBenchmark {
+public:
+	BoxBenchmark(unsigned int boxCount, unsigned int queryCount);
+
+	int run(void);
+
+private:
+	struct Query {
+		Vector2 center;
+		Vector2 halfSize;
+		Vector2 axis;
+		size_t first;
+		Vector2 min;
+		Vector2 max;
+	};
+
+	BoxArray boxes;
+	std::vector<Query> queries;
+	std::mt19937 random;
+
+	Vector2 randomLocation(void);
+	Vector2 randomHalfSize(void);
+	Vector2 randomAxis(void);
+
+	bool compare(const char *name, const std::vector<size_t> &vectorized, double vectorizedTime,
+	             const std::vector<size_t> &scalar, double scalarTime);
+};
+
+#endif
@@ -0,0 +1,413 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "bot.h"
+
+// The cards of the core package
+const char CARD_RANKS[] = "23456789TJQKA";
+const char CARD_SUITS[] = "cdhs";
+
+Statistics::Statistics() {
+	this->clear();
+}
+
+void Statistics::clear() {
+	this->commandsSent = 0;
+	this->commandsEchoed = 0;
+	this->commandsLost = 0;
+	this->packetsReceived = 0;
+	this->bytesSent = 0;
+	this->bytesReceived = 0;
+	this->latencies.clear();
+}
+
+void Statistics::add(const Statistics &statistics) {
+	this->commandsSent += statistics.commandsSent;
+	this->commandsEchoed += statistics.commandsEchoed;
+	this->commandsLost += statistics.commandsLost;
+	this->packetsReceived += statistics.packetsReceived;
+	this->bytesSent += statistics.bytesSent;
+	this->bytesReceived += statistics.bytesReceived;
+
+	for (auto &latency : statistics.latencies) {
+		this->latencies[latency.first].add(latency.second);
+	}
+}
+
+Bot::Bot(ENetPeer *peer, std::string nick, const Profile &profile, Statistics *statistics, unsigned int seed)
+: peer(peer),
+  nick(nick),
+  profile(profile),
+  statistics(statistics),
+  connection(false),
+  joined(false),
+  id(255),
+  randomGenerator(seed),
+  actionDistribution({static_cast<double>(profile.chat), static_cast<double>(profile.drag),
+                      static_cast<double>(profile.flip), static_cast<double>(profile.shuffle)}),
+  nextActionTime(0.0),
+  chatCounter(0),
+  stampSequence(0) {
+	// Give every bot its own area of the table
+	std::uniform_real_distribution<float> coordinate(-0.9f * net::MAX_FLOAT, 0.9f * net::MAX_FLOAT);
+	this->home = Vector2(coordinate(this->randomGenerator), coordinate(this->randomGenerator));
+}
+
+std::string Bot::getCommandName(Packet::Header header) {
+	switch (header) {
+		case Packet::Header::HANDSHAKE: return "handshake";
+		case Packet::Header::CREATE:    return "create";
+		case Packet::Header::SELECT:    return "select";
+		case Packet::Header::MOVE:      return "move";
+		case Packet::Header::FLIP:      return "flip";
+		case Packet::Header::SHUFFLE:   return "shuffle";
+		case Packet::Header::CHAT:      return "chat";
+		default:                        return "other";
+	}
+}
+
+ENetPeer* Bot::getPeer() const {
+	return this->peer;
+}
+
+std::string Bot::getNick() const {
+	return this->nick;
+}
+
+bool Bot::isConnected() const {
+	return this->connection;
+}
+
+bool Bot::isJoined() const {
+	return this->joined;
+}
+
+void Bot::connected() {
+	this->connection = true;
+	this->identify();
+}
+
+void Bot::disconnected() {
+	this->connection = false;
+	this->joined = false;
+	this->pending.clear();
+	this->sentStamps.clear();
+}
+
+void Bot::receivePacket(ENetPacket *enetPacket) {
+	++this->statistics->packetsReceived;
+	this->statistics->bytesReceived += enetPacket->dataLength;
+
+	Packet packet(enetPacket);
+	Packet::Header header = packet.readHeader();
+
+	// Only the commands sent by this bot are interesting
+	const bool own = this->joined && ! this->profile.spectator && enetPacket->dataLength >= 2 && enetPacket->data[1] == this->id;
+
+	switch (header) {
+		case Packet::Header::HANDSHAKE: {
+			if (enetPacket->dataLength >= 2) {
+				this->id = enetPacket->data[1];
+				this->joined = true;
+				this->nextActionTime = utils::getTime();
+
+				this->receiveEcho(header);
+				this->createDecks();
+			}
+
+			break;
+		}
+
+		case Packet::Header::NICK_TAKEN: {
+			this->pending.clear();
+			this->nick = this->nick.substr(0, 12) + utils::toString(this->randomGenerator() % 1000);
+			this->identify();
+
+			break;
+		}
+
+		case Packet::Header::CREATE: {
+			// Keep track of every object on the table
+			size_t i = 2;
+			while (i + 15 <= enetPacket->dataLength) {
+				this->objects.push_back(net::bytesToShort(enetPacket->data + i));
+				i += 15 + enetPacket->data[i + 14];
+			}
+
+			if (own) {
+				this->receiveEcho(header);
+			}
+
+			break;
+		}
+
+		case Packet::Header::REMOVE: {
+			for (size_t i = 2; i + 2 <= enetPacket->dataLength; i += 2) {
+				const unsigned short object = net::bytesToShort(enetPacket->data + i);
+
+				this->objects.erase(std::remove(this->objects.begin(), this->objects.end(), object), this->objects.end());
+				this->selection.erase(std::remove(this->selection.begin(), this->selection.end(), object), this->selection.end());
+			}
+
+			break;
+		}
+
+		case Packet::Header::MOVE:
+		case Packet::Header::SELECT:
+		case Packet::Header::FLIP:
+		case Packet::Header::CHAT: {
+			if (own) {
+				this->receiveEcho(header);
+			}
+
+			break;
+		}
+
+		case Packet::Header::STAMP: {
+			if (this->joined) {
+				this->receiveStamp(packet);
+			}
+
+			break;
+		}
+
+		case Packet::Header::TIME: {
+			trace::addClockSample(packet.readTime(), this->peer->roundTripTime / 1000.0);
+
+			break;
+		}
+
+		default: {
+			break;
+		}
+	}
+}
+
+void Bot::update(double time) {
+	// Forget the commands that the server never answered
+	for (auto &queue : this->pending) {
+		while (!queue.second.empty() && queue.second.front().second + COMMAND_TIMEOUT < time) {
+			queue.second.pop_front();
+			++this->statistics->commandsLost;
+		}
+	}
+
+	if (!this->joined || time < this->nextActionTime || this->profile.rate <= 0.0f) {
+		return;
+	}
+
+	const int action = this->actionDistribution(this->randomGenerator);
+
+	// The object actions have to wait until somebody has created objects
+	if (action == 0) {
+		this->chat();
+	} else if (!this->objects.empty()) {
+		switch (action) {
+			case 1: this->drag(); break;
+			case 2: this->flip(); break;
+			case 3: this->shuffle(); break;
+		}
+	}
+
+	// Poisson distributed actions
+	std::exponential_distribution<double> delay(this->profile.rate);
+	this->nextActionTime = time + delay(this->randomGenerator);
+}
+
+void Bot::send(const std::string &data, Packet::Header echo) {
+	net::sendCommand(this->peer, data.c_str(), data.length());
+
+	++this->statistics->commandsSent;
+	this->statistics->bytesSent += data.length();
+
+	const Packet::Header header = static_cast<Packet::Header>(data.at(0));
+	this->pending[echo].push_back(std::make_pair(header, utils::getTime()));
+
+	if (header >= Packet::Header::CREATE && header < Packet::Header::CHAT) {
+		this->sendStamp();
+	}
+}
+
+void Bot::sendStamp() {
+	if (! this->profile.stamps) {
+		return;
+	}
+
+	Packet packet(this->peer);
+	packet.writeHeader(Packet::Header::STAMP);
+	packet.writeShort(this->stampSequence);
+	packet.send();
+
+	this->sentStamps[this->stampSequence] = utils::getTime();
+	++this->stampSequence;
+}
+
+// The server times are comparable only after the clocks are synchronized
+void Bot::receiveStamp(Packet &packet) {
+	const unsigned char client = packet.readByte();
+	const unsigned short sequence = packet.readShort();
+	const double receiveTime = packet.readTime();
+	const double sendTime = packet.readTime();
+
+	if (client == this->id) {
+		std::map<unsigned short, double>::iterator stamp = this->sentStamps.find(sequence);
+
+		if (stamp != this->sentStamps.end()) {
+			if (trace::isClockSynchronized()) {
+				this->statistics->latencies["input to server"].add((receiveTime - stamp->second - trace::getClockOffset()) * 1000.0);
+			}
+
+			this->sentStamps.erase(stamp);
+		}
+	} else if (trace::isClockSynchronized()) {
+		this->statistics->latencies["server to peers"].add((trace::getServerTime() - sendTime) * 1000.0);
+	}
+}
+
+// The server handles the commands of a client in order, so the oldest command is answered first
+void Bot::receiveEcho(Packet::Header header) {
+	auto queue = this->pending.find(header);
+	if (queue == this->pending.end() || queue->second.empty()) {
+		return;
+	}
+
+	const std::pair<Packet::Header, double> command = queue->second.front();
+	queue->second.pop_front();
+
+	++this->statistics->commandsEchoed;
+	this->statistics->latencies[Bot::getCommandName(command.first)].add((utils::getTime() - command.second) * 1000.0);
+}
+
+void Bot::identify() {
+	std::string data;
+
+	if (this->profile.spectator) {
+		data.push_back(static_cast<char>(Packet::Header::SPECTATE));
+	} else {
+		data.push_back(net::PACKET_HANDSHAKE);
+	}
+
+	data.append(this->nick, 0, 16);
+
+	this->send(data, Packet::Header::HANDSHAKE);
+}
+
+void Bot::createDecks() {
+	if (this->profile.decks == 0) {
+		return;
+	}
+
+	std::string data;
+	data.push_back(net::PACKET_CREATE);
+
+	for (unsigned int deck = 0; deck < this->profile.decks; ++deck) {
+		for (const char *rank = CARD_RANKS; *rank != '\0'; ++rank) {
+			for (const char *suit = CARD_SUITS; *suit != '\0'; ++suit) {
+				const std::string objectId = std::string("core.card.") + *rank + *suit;
+
+				data += 255; // Not selected
+				data += 255; // Not owned
+				data += true; // Flipped
+				net::dataAppendVector2(data, this->home + Vector2(deck * 200.0f, 0.0f));
+				data.push_back(0x00); // Not rotated
+				data += objectId.size();
+				data.append(objectId);
+			}
+		}
+	}
+
+	this->send(data, Packet::Header::CREATE);
+}
+
+void Bot::select(std::vector<unsigned short> objects) {
+	std::string data;
+	data.push_back(net::PACKET_SELECT);
+
+	for (auto &object : objects) {
+		net::dataAppendShort(data, object);
+	}
+
+	this->selection = objects;
+	this->send(data, Packet::Header::SELECT);
+}
+
+// Select a random run of at most the given amount of objects
+void Bot::selectRandom(size_t maxAmount) {
+	std::uniform_int_distribution<size_t> first(0, this->objects.size() - 1);
+	std::uniform_int_distribution<size_t> amount(1, maxAmount);
+
+	std::vector<unsigned short>::iterator begin = this->objects.begin() + first(this->randomGenerator);
+	std::vector<unsigned short>::iterator end = begin + std::min(amount(this->randomGenerator),
+	                                                             static_cast<size_t>(this->objects.end() - begin));
+	this->select(std::vector<unsigned short>(begin, end));
+}
+
+// Pick up a pile of objects and drop it somewhere near the home location
+void Bot::drag() {
+	this->selectRandom(5);
+
+	std::uniform_real_distribution<float> offset(-500.0f, 500.0f);
+	Vector2 location = this->home + Vector2(offset(this->randomGenerator), offset(this->randomGenerator));
+
+	std::string data;
+	data.push_back(net::PACKET_MOVE);
+
+	for (auto &object : this->selection) {
+		net::dataAppendShort(data, object);
+		net::dataAppendVector2(data, location);
+		location += Vector2(4.0f, 0.0f);
+	}
+
+	this->send(data, Packet::Header::MOVE);
+}
+
+void Bot::flip() {
+	if (this->selection.empty()) {
+		this->selectRandom(1);
+	}
+
+	std::string data;
+	data.push_back(net::PACKET_FLIP);
+	data += this->randomGenerator() % 2;
+
+	for (auto &object : this->selection) {
+		net::dataAppendShort(data, object);
+	}
+
+	this->send(data, Packet::Header::FLIP);
+}
+
+// Select a deck worth of objects and let the server shuffle them
+void Bot::shuffle() {
+	this->selectRandom(52);
+
+	std::string data;
+	data.push_back(net::PACKET_SHUFFLE);
+
+	// The server answers a shuffle with a move
+	this->send(data, Packet::Header::MOVE);
+}
+
+void Bot::chat() {
+	++this->chatCounter;
+
+	std::string data;
+	data.push_back(net::PACKET_CHAT);
+	data.append("Load test message " + utils::toString(this->chatCounter) + ".");
+
+	this->send(data, Packet::Header::CHAT);
+}
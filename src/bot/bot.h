@@ -0,0 +1,127 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BOT_H
+#define BOT_H
+
+#include <map>
+#include <deque>
+#include <vector>
+#include <string>
+#include <random>
+#include <utility>
+#include <algorithm>
+
+#include <enet/enet.h>
+
+#include "../net.h"
+#include "../packet.h"
+#include "../utils.h"
+#include "../vector2.h"
+#include "../histogram.h"
+#include "../trace.h"
+
+// Commands that have not been echoed back in this time are considered lost
+const double COMMAND_TIMEOUT = 10.0;
+
+// Counters shared by all simulated players
+struct Statistics {
+	unsigned int commandsSent;
+	unsigned int commandsEchoed;
+	unsigned int commandsLost;
+	unsigned int packetsReceived;
+	unsigned long long bytesSent;
+	unsigned long long bytesReceived;
+
+	// End-to-end latencies by command name
+	std::map<std::string, Histogram> latencies;
+
+	Statistics(void);
+	void clear(void);
+	void add(const Statistics &statistics);
+};
+
+class Bot {
+public:
+	// Describes how a simulated player behaves
+	struct Profile {
+		bool spectator;        // Join as a spectator and only receive
+		float rate;            // Actions per second
+		unsigned int decks;    // Decks to create after joining
+		unsigned int chat;     // Relative weights of the actions
+		unsigned int drag;
+		unsigned int flip;
+		unsigned int shuffle;
+		bool stamps;           // Follow the object commands with latency stamps
+	};
+
+	Bot(ENetPeer *peer, std::string nick, const Profile &profile, Statistics *statistics, unsigned int seed);
+
+	static std::string getCommandName(Packet::Header header);
+
+	ENetPeer* getPeer(void) const;
+	std::string getNick(void) const;
+	bool isConnected(void) const;
+	bool isJoined(void) const;
+
+	void connected(void);
+	void disconnected(void);
+	void receivePacket(ENetPacket *packet);
+	void update(double time);
+
+private:
+	ENetPeer *peer;
+	std::string nick;
+	Profile profile;
+	Statistics *statistics;
+
+	bool connection;
+	bool joined;
+	unsigned char id;
+
+	std::mt19937 randomGenerator;
+	std::discrete_distribution<int> actionDistribution;
+	double nextActionTime;
+	unsigned int chatCounter;
+
+	Vector2 home;
+	std::vector<unsigned short> objects; // All objects on the table
+	std::vector<unsigned short> selection;
+
+	// Send times of the commands waiting for the server echo by the echo header
+	std::map<Packet::Header, std::deque<std::pair<Packet::Header, double>>> pending;
+
+	// Send times of the latency stamps by sequence number
+	unsigned short stampSequence;
+	std::map<unsigned short, double> sentStamps;
+
+	void send(const std::string &data, Packet::Header echo);
+	void receiveEcho(Packet::Header header);
+	void sendStamp(void);
+	void receiveStamp(Packet &packet);
+
+	void identify(void);
+	void createDecks(void);
+	void select(std::vector<unsigned short> objects);
+	void selectRandom(size_t maxAmount);
+	void drag(void);
+	void flip(void);
+	void shuffle(void);
+	void chat(void);
+};
+
+#endif
@@ -0,0 +1,296 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "main.h"
+
+int main(int argc, char **argv) {
+	// Get server address, port and the number of bots from command line arguments
+	std::string address;
+	unsigned int port = 0;
+	unsigned int botCount = 0;
+
+	if (argc >= 2) {
+		address = std::string(argv[1]);
+	}
+
+	if (argc >= 3) {
+		std::istringstream portString(argv[2]);
+		portString >> port;
+	}
+
+	if (argc >= 4) {
+		std::istringstream countString(argv[3]);
+		countString >> botCount;
+	}
+
+	LoadTest loadTest = LoadTest(address, port, botCount);
+	LoadTest::loadTestPtr = &loadTest;
+
+	return loadTest.run();
+}
+
+LoadTest *LoadTest::loadTestPtr;
+
+void LoadTest::catchSignal(int signal) {
+	std::cout << std::endl << "Exiting.." << std::endl;
+
+	LoadTest::loadTestPtr->exit();
+}
+
+LoadTest::LoadTest(std::string address, unsigned int port, unsigned int botCount)
+: host(address),
+  connection(nullptr),
+  botCount(botCount),
+  exiting(false),
+  startTime(0.0),
+  lastReportTime(0.0) {
+	this->address.host = ENET_HOST_ANY;
+	this->address.port = port;
+
+	this->settings = new Settings("bot.cfg");
+}
+
+LoadTest::~LoadTest() {
+	for (auto &bot : this->bots) {
+		delete bot;
+	}
+
+	delete this->settings;
+}
+
+int LoadTest::run() {
+	// Check the command line parameters
+	if (this->host.empty()) {
+		this->host = this->settings->getValue<std::string>("network.server");
+	}
+
+	if (this->address.port == 0) {
+		this->address.port = this->settings->getValue<int>("network.port");
+	}
+
+	if (this->botCount == 0) {
+		this->botCount = this->settings->getValue<int>("bot.count");
+	}
+
+	this->loadProfiles();
+
+	if (this->profiles.empty()) {
+		std::cerr << "No behaviour profiles configured!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// Catch SIGINT
+	signal(SIGINT, catchSignal);
+
+	// Initialize ENet
+	if (enet_initialize() != 0) {
+		std::cerr << "Could not initialize network components!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	if (enet_address_set_host(&this->address, this->host.c_str()) < 0) {
+		std::cerr << "Unknown host " << this->host << "!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	// All bots share one host with a peer for each of them
+	this->connection = enet_host_create(nullptr, this->botCount, net::CHANNELS, 0, 0);
+
+	if (this->connection == nullptr) {
+		std::cerr << "Could not create a connection!" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::string nick = this->settings->getValue<std::string>("bot.nick");
+	std::vector<std::string> profileNames = this->settings->getList<std::string>("bot.profiles");
+	std::random_device seed;
+
+	for (unsigned int i = 0; i < this->botCount; ++i) {
+		ENetPeer *peer = enet_host_connect(this->connection, &this->address, 1, 0);
+
+		if (peer == nullptr) {
+			std::cerr << "Could not connect bot " << i << " to the server!" << std::endl;
+			break;
+		}
+
+		// The profiles are assigned to the bots in turns
+		const std::string &profile = profileNames.at(i % profileNames.size());
+
+		Bot *bot = new Bot(peer, nick + utils::toString(i), this->profiles.at(profile), &this->statistics, seed());
+		peer->data = bot;
+		this->bots.push_back(bot);
+	}
+
+	std::cout << "Connecting " << this->bots.size() << " bots to " << net::AddressToString(this->address) << "." << std::endl;
+
+	this->startTime = utils::getTime();
+	this->lastReportTime = this->startTime;
+
+	// Enter the main loop
+	this->mainLoop();
+
+	this->disconnect();
+
+	// Print the results of the whole run
+	this->totalStatistics.add(this->statistics);
+	std::cout << std::endl << "Total:" << std::endl;
+	this->printStatistics(this->totalStatistics, utils::getTime() - this->startTime);
+
+	// Exit the load test
+	this->dispose();
+	return EXIT_SUCCESS;
+}
+
+void LoadTest::exit() {
+	this->exiting = true;
+}
+
+void LoadTest::loadProfiles() {
+	for (auto &name : this->settings->getList<std::string>("bot.profiles")) {
+		const std::string path = "profile." + name + ".";
+
+		Bot::Profile profile;
+		profile.spectator = this->settings->getValue<bool>(path + "spectator");
+		profile.rate    = this->settings->getValue<float>(path + "rate");
+		profile.decks   = this->settings->getValue<int>(path + "decks");
+		profile.chat    = this->settings->getValue<int>(path + "chat");
+		profile.drag    = this->settings->getValue<int>(path + "drag");
+		profile.flip    = this->settings->getValue<int>(path + "flip");
+		profile.shuffle = this->settings->getValue<int>(path + "shuffle");
+		profile.stamps  = this->settings->getValue<bool>("bot.latencystamps");
+
+		this->profiles[name] = profile;
+	}
+}
+
+void LoadTest::mainLoop() {
+	const double duration = this->settings->getValue<float>("bot.duration");
+
+	while (! this->exiting) {
+		this->networkEvents();
+
+		const double time = utils::getTime();
+
+		for (auto &bot : this->bots) {
+			bot->update(time);
+		}
+
+		this->report(time);
+
+		if (duration > 0.0 && time > this->startTime + duration) {
+			this->exit();
+		}
+	}
+}
+
+void LoadTest::disconnect() {
+	unsigned int connected = 0;
+	for (auto &bot : this->bots) {
+		if (bot->isConnected()) {
+			enet_peer_disconnect(bot->getPeer(), 0);
+			++connected;
+		}
+	}
+
+	// Allow up to 3 seconds for the disconnect to succeed
+	ENetEvent event;
+	while (connected > 0 && enet_host_service(this->connection, &event, 3000) > 0) {
+		if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+			enet_packet_destroy(event.packet);
+		} else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+			--connected;
+		}
+	}
+}
+
+void LoadTest::dispose() {
+	enet_host_destroy(this->connection);
+	enet_deinitialize();
+}
+
+void LoadTest::networkEvents() {
+	ENetEvent event;
+
+	// Wait up to 1 millisecond for an event to keep the bots running on time.
+	while (enet_host_service(this->connection, &event, 1) > 0) {
+		Bot *bot = static_cast<Bot*>(event.peer->data);
+
+		switch (event.type) {
+			case ENET_EVENT_TYPE_CONNECT: {
+				bot->connected();
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_RECEIVE: {
+				bot->receivePacket(event.packet);
+
+				enet_packet_destroy(event.packet);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_DISCONNECT: {
+				std::cout << bot->getNick() << " was disconnected from the server!" << std::endl;
+				bot->disconnected();
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_NONE: {
+				break;
+			}
+		}
+	}
+}
+
+void LoadTest::report(double time) {
+	const double interval = this->settings->getValue<float>("bot.reportinterval");
+
+	if (time < this->lastReportTime + interval) {
+		return;
+	}
+
+	unsigned int joined = 0;
+	for (auto &bot : this->bots) {
+		if (bot->isJoined()) {
+			++joined;
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(1) << "[" << time - this->startTime << " s] "
+	          << joined << "/" << this->bots.size() << " bots joined" << std::endl;
+	this->printStatistics(this->statistics, time - this->lastReportTime);
+
+	this->totalStatistics.add(this->statistics);
+	this->statistics.clear();
+	this->lastReportTime = time;
+}
+
+void LoadTest::printStatistics(const Statistics &statistics, double duration) {
+	std::cout << std::fixed << std::setprecision(1)
+	          << "  " << statistics.commandsSent / duration << " commands/s sent, "
+	          << statistics.commandsEchoed / duration << "/s echoed, "
+	          << statistics.commandsLost << " lost" << std::endl
+	          << "  received " << statistics.packetsReceived / duration << " packets/s ("
+	          << net::getPrettyFileSize(statistics.bytesReceived / duration) << "/s), sent "
+	          << net::getPrettyFileSize(statistics.bytesSent / duration) << "/s" << std::endl;
+
+	for (auto &latency : statistics.latencies) {
+		std::cout << "  " << latency.first << ": " << latency.second.getSummary() << std::endl;
+	}
+}
@@ -0,0 +1,83 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MAIN_H
+#define MAIN_H
+
+#include <cstdlib>
+#include <csignal>
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+
+#include <enet/enet.h>
+
+#include "../net.h"
+#include "../utils.h"
+#include "../settings.h"
+#include "../histogram.h"
+#include "bot.h"
+
+class LoadTest;
+
+int main(int argc, char **argv);
+
+// Runs a number of simulated players against a game server and reports
+// the command latencies and the traffic.
+class LoadTest {
+public:
+	LoadTest(std::string address, unsigned int port, unsigned int botCount);
+	~LoadTest(void);
+
+	static LoadTest *loadTestPtr;
+	static void catchSignal(int signal);
+
+	int run(void);
+	void exit(void);
+
+private:
+	std::string host;
+	ENetAddress address;
+	ENetHost *connection;
+
+	Settings *settings;
+
+	unsigned int botCount;
+	std::vector<Bot*> bots;
+	std::map<std::string, Bot::Profile> profiles;
+
+	Statistics statistics;
+	Statistics totalStatistics;
+
+	bool exiting;
+
+	double startTime;
+	double lastReportTime;
+
+	void loadProfiles(void);
+	void mainLoop(void);
+	void disconnect(void);
+	void dispose(void);
+
+	void networkEvents(void);
+	void report(double time);
+	void printStatistics(const Statistics &statistics, double duration);
+};
+
+#endif
@@ -0,0 +1,180 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "boxArray.h"
+
+void BoxArray::clear() {
+	this->centerX.clear();
+	this->centerY.clear();
+	this->halfX.clear();
+	this->halfY.clear();
+	this->axisX.clear();
+	this->axisY.clear();
+}
+
+void BoxArray::reserve(size_t size) {
+	this->centerX.reserve(size);
+	this->centerY.reserve(size);
+	this->halfX.reserve(size);
+	this->halfY.reserve(size);
+	this->axisX.reserve(size);
+	this->axisY.reserve(size);
+}
+
+void BoxArray::add(Vector2 center, Vector2 halfSize, Vector2 axis) {
+	this->centerX.push_back(center.x);
+	this->centerY.push_back(center.y);
+	this->halfX.push_back(halfSize.x);
+	this->halfY.push_back(halfSize.y);
+	this->axisX.push_back(axis.x);
+	this->axisY.push_back(axis.y);
+}
+
+size_t BoxArray::size() const {
+	return this->centerX.size();
+}
+
+// Separating axis test against the edge normals of both boxes. With the y
+// axes perpendicular to the x axes, the dot products between the axes of
+// the boxes reduce to the cosine c and the sine s of the angle between them.
+void BoxArray::queryOverlaps(Vector2 center, Vector2 halfSize, Vector2 axis, size_t first, std::vector<size_t> &overlaps) const {
+	size_t i = first;
+
+#if defined __SSE2__
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 queryX = _mm_set1_ps(center.x);
+	const __m128 queryY = _mm_set1_ps(center.y);
+	const __m128 queryHalfX = _mm_set1_ps(halfSize.x);
+	const __m128 queryHalfY = _mm_set1_ps(halfSize.y);
+	const __m128 queryAxisX = _mm_set1_ps(axis.x);
+	const __m128 queryAxisY = _mm_set1_ps(axis.y);
+
+	for (; i + 4 <= this->size(); i += 4) {
+		const __m128 axisX = _mm_loadu_ps(&this->axisX[i]);
+		const __m128 axisY = _mm_loadu_ps(&this->axisY[i]);
+		const __m128 halfX = _mm_loadu_ps(&this->halfX[i]);
+		const __m128 halfY = _mm_loadu_ps(&this->halfY[i]);
+		const __m128 deltaX = _mm_sub_ps(_mm_loadu_ps(&this->centerX[i]), queryX);
+		const __m128 deltaY = _mm_sub_ps(_mm_loadu_ps(&this->centerY[i]), queryY);
+
+		const __m128 c = _mm_andnot_ps(signMask, _mm_add_ps(_mm_mul_ps(axisX, queryAxisX), _mm_mul_ps(axisY, queryAxisY)));
+		const __m128 s = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(axisY, queryAxisX), _mm_mul_ps(axisX, queryAxisY)));
+
+		// The distances of the centres along the query axes and the box axes
+		const __m128 distanceQueryX = _mm_andnot_ps(signMask, _mm_add_ps(_mm_mul_ps(deltaX, queryAxisX), _mm_mul_ps(deltaY, queryAxisY)));
+		const __m128 distanceQueryY = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(deltaY, queryAxisX), _mm_mul_ps(deltaX, queryAxisY)));
+		const __m128 distanceBoxX = _mm_andnot_ps(signMask, _mm_add_ps(_mm_mul_ps(deltaX, axisX), _mm_mul_ps(deltaY, axisY)));
+		const __m128 distanceBoxY = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_mul_ps(deltaY, axisX), _mm_mul_ps(deltaX, axisY)));
+
+		__m128 overlap = _mm_cmple_ps(distanceQueryX, _mm_add_ps(queryHalfX, _mm_add_ps(_mm_mul_ps(halfX, c), _mm_mul_ps(halfY, s))));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(distanceQueryY, _mm_add_ps(queryHalfY, _mm_add_ps(_mm_mul_ps(halfX, s), _mm_mul_ps(halfY, c)))));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(distanceBoxX, _mm_add_ps(halfX, _mm_add_ps(_mm_mul_ps(queryHalfX, c), _mm_mul_ps(queryHalfY, s)))));
+		overlap = _mm_and_ps(overlap, _mm_cmple_ps(distanceBoxY, _mm_add_ps(halfY, _mm_add_ps(_mm_mul_ps(queryHalfX, s), _mm_mul_ps(queryHalfY, c)))));
+
+		int mask = _mm_movemask_ps(overlap);
+		while (mask != 0) {
+			const int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+			overlaps.push_back(i + lane);
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	this->queryOverlapsScalar(center, halfSize, axis, i, overlaps);
+}
+
+// A box is inside the rectangle when its axis aligned bounds are
+void BoxArray::queryContained(Vector2 min, Vector2 max, std::vector<size_t> &contained) const {
+	size_t i = 0;
+
+#if defined __SSE2__
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	const __m128 minX = _mm_set1_ps(min.x);
+	const __m128 minY = _mm_set1_ps(min.y);
+	const __m128 maxX = _mm_set1_ps(max.x);
+	const __m128 maxY = _mm_set1_ps(max.y);
+
+	for (; i + 4 <= this->size(); i += 4) {
+		const __m128 axisX = _mm_andnot_ps(signMask, _mm_loadu_ps(&this->axisX[i]));
+		const __m128 axisY = _mm_andnot_ps(signMask, _mm_loadu_ps(&this->axisY[i]));
+		const __m128 halfX = _mm_loadu_ps(&this->halfX[i]);
+		const __m128 halfY = _mm_loadu_ps(&this->halfY[i]);
+		const __m128 centerX = _mm_loadu_ps(&this->centerX[i]);
+		const __m128 centerY = _mm_loadu_ps(&this->centerY[i]);
+
+		const __m128 extentX = _mm_add_ps(_mm_mul_ps(halfX, axisX), _mm_mul_ps(halfY, axisY));
+		const __m128 extentY = _mm_add_ps(_mm_mul_ps(halfX, axisY), _mm_mul_ps(halfY, axisX));
+
+		__m128 inside = _mm_cmplt_ps(minX, _mm_sub_ps(centerX, extentX));
+		inside = _mm_and_ps(inside, _mm_cmplt_ps(_mm_add_ps(centerX, extentX), maxX));
+		inside = _mm_and_ps(inside, _mm_cmplt_ps(minY, _mm_sub_ps(centerY, extentY)));
+		inside = _mm_and_ps(inside, _mm_cmplt_ps(_mm_add_ps(centerY, extentY), maxY));
+
+		int mask = _mm_movemask_ps(inside);
+		while (mask != 0) {
+			const int lane = mask & 1 ? 0 : mask & 2 ? 1 : mask & 4 ? 2 : 3;
+			contained.push_back(i + lane);
+			mask &= mask - 1;
+		}
+	}
+#endif
+
+	for (; i < this->size(); ++i) {
+		if (this->testContained(i, min, max)) {
+			contained.push_back(i);
+		}
+	}
+}
+
+void BoxArray::queryOverlapsScalar(Vector2 center, Vector2 halfSize, Vector2 axis, size_t first, std::vector<size_t> &overlaps) const {
+	for (size_t i = first; i < this->size(); ++i) {
+		if (this->testOverlap(i, center, halfSize, axis)) {
+			overlaps.push_back(i);
+		}
+	}
+}
+
+void BoxArray::queryContainedScalar(Vector2 min, Vector2 max, std::vector<size_t> &contained) const {
+	for (size_t i = 0; i < this->size(); ++i) {
+		if (this->testContained(i, min, max)) {
+			contained.push_back(i);
+		}
+	}
+}
+
+bool BoxArray::testOverlap(size_t box, Vector2 center, Vector2 halfSize, Vector2 axis) const {
+	const float deltaX = this->centerX[box] - center.x;
+	const float deltaY = this->centerY[box] - center.y;
+	const float c = std::abs(this->axisX[box] * axis.x + this->axisY[box] * axis.y);
+	const float s = std::abs(this->axisY[box] * axis.x - this->axisX[box] * axis.y);
+
+	// Summed in the same order as the SSE version so that both give the same results
+	return std::abs(deltaX * axis.x + deltaY * axis.y) <= halfSize.x + (this->halfX[box] * c + this->halfY[box] * s)
+	       && std::abs(deltaY * axis.x - deltaX * axis.y) <= halfSize.y + (this->halfX[box] * s + this->halfY[box] * c)
+	       && std::abs(deltaX * this->axisX[box] + deltaY * this->axisY[box]) <= this->halfX[box] + (halfSize.x * c + halfSize.y * s)
+	       && std::abs(deltaY * this->axisX[box] - deltaX * this->axisY[box]) <= this->halfY[box] + (halfSize.x * s + halfSize.y * c);
+}
+
+bool BoxArray::testContained(size_t box, Vector2 min, Vector2 max) const {
+	const float axisX = std::abs(this->axisX[box]);
+	const float axisY = std::abs(this->axisY[box]);
+	const float extentX = this->halfX[box] * axisX + this->halfY[box] * axisY;
+	const float extentY = this->halfX[box] * axisY + this->halfY[box] * axisX;
+
+	return min.x < this->centerX[box] - extentX && this->centerX[box] + extentX < max.x
+	       && min.y < this->centerY[box] - extentY && this->centerY[box] + extentY < max.y;
+}
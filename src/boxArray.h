@@ -0,0 +1,66 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BOXARRAY_H
+#define BOXARRAY_H
+
+#include <vector>
+#include <cmath>
+
+#if defined __SSE2__
+	#include <emmintrin.h>
+#endif
+
+#include "vector2.h"
+
+// Oriented boxes stored as a structure of arrays, so that one query box can
+// be tested against several boxes at a time with SSE. Each box has a centre,
+// half extents and the unit vector of its x axis, the y axis is
+// perpendicular to it. Builds without SSE2 use the scalar version.
+class BoxArray {
+public:
+	void clear(void);
+	void reserve(size_t size);
+	void add(Vector2 center, Vector2 halfSize, Vector2 axis);
+	size_t size(void) const;
+
+	// Append the indices of the boxes from the first one on that overlap the
+	// query box
+	void queryOverlaps(Vector2 center, Vector2 halfSize, Vector2 axis, size_t first, std::vector<size_t> &overlaps) const;
+
+	// Append the indices of the boxes that are completely inside the axis
+	// aligned rectangle
+	void queryContained(Vector2 min, Vector2 max, std::vector<size_t> &contained) const;
+
+	// The same queries without SSE, for checking and timing the vectorized
+	// versions against
+	void queryOverlapsScalar(Vector2 center, Vector2 halfSize, Vector2 axis, size_t first, std::vector<size_t> &overlaps) const;
+	void queryContainedScalar(Vector2 min, Vector2 max, std::vector<size_t> &contained) const;
+
+private:
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> halfX;
+	std::vector<float> halfY;
+	std::vector<float> axisX;
+	std::vector<float> axisY;
+
+	bool testOverlap(size_t box, Vector2 center, Vector2 halfSize, Vector2 axis) const;
+	bool testContained(size_t box, Vector2 min, Vector2 max) const;
+};
+
+#endif
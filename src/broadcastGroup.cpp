@@ -0,0 +1,88 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "broadcastGroup.h"
+
+BroadcastGroup::BroadcastGroup()
+: next(nullptr) {}
+
+void BroadcastGroup::add(ENetPeer *peer) {
+	if (std::find(this->peers.begin(), this->peers.end(), peer) == this->peers.end()) {
+		this->peers.push_back(peer);
+	}
+}
+
+void BroadcastGroup::remove(ENetPeer *peer) {
+	this->peers.erase(std::remove(this->peers.begin(), this->peers.end(), peer), this->peers.end());
+}
+
+size_t BroadcastGroup::size() const {
+	return this->peers.size();
+}
+
+bool BroadcastGroup::empty() const {
+	return this->peers.empty();
+}
+
+// Whether neither this group nor the groups after it have any peers
+bool BroadcastGroup::isChainEmpty() const {
+	for (const BroadcastGroup *group = this; group != nullptr; group = group->next) {
+		if (! group->empty()) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void BroadcastGroup::setNext(BroadcastGroup *next) {
+	this->next = next;
+}
+
+void BroadcastGroup::send(const char *data, size_t length, bool isReliable) {
+	int flags = 0;
+
+	if (isReliable) {
+		flags |= ENET_PACKET_FLAG_RELIABLE;
+	}
+
+	this->send(enet_packet_create(data, length, flags));
+}
+
+void BroadcastGroup::send(ENetPacket *packet) {
+	// Hold a reference of our own so that ENet can't free the packet
+	// while it is still being queued for the rest of the peers.
+	++packet->referenceCount;
+
+	for (auto &peer : this->peers) {
+		enet_peer_send(peer, 0, packet);
+	}
+
+	// An empty group in the middle doesn't stop the chain
+	if (this->next != nullptr && ! this->next->isChainEmpty()) {
+		// Put the packets of this group on the wire before queuing the rest
+		if (! this->peers.empty()) {
+			enet_host_flush(this->peers.front()->host);
+		}
+
+		this->next->send(packet);
+	}
+
+	if (--packet->referenceCount == 0) {
+		enet_packet_destroy(packet);
+	}
+}
@@ -0,0 +1,49 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BROADCASTGROUP_H
+#define BROADCASTGROUP_H
+
+#include <vector>
+#include <algorithm>
+
+#include <enet/enet.h>
+
+// A set of peers that receive the same packets. The packet is created once
+// and shared by all the peers of the group and of the groups chained after it.
+class BroadcastGroup {
+public:
+	BroadcastGroup(void);
+
+	void add(ENetPeer *peer);
+	void remove(ENetPeer *peer);
+	size_t size(void) const;
+	bool empty(void) const;
+	bool isChainEmpty(void) const;
+
+	// The next group receives every packet after this one has been flushed
+	void setNext(BroadcastGroup *next);
+
+	void send(const char *data, size_t length, bool isReliable = true);
+	void send(ENetPacket *packet);
+
+private:
+	std::vector<ENetPeer*> peers;
+	BroadcastGroup *next;
+};
+
+#endif
@@ -21,16 +21,16 @@
 #include <sstream>
 #include <iomanip>
 
-Client::Client(unsigned char id)
+Client::Client(unsigned short id)
 : id(id) {}
 
-Client::Client(std::string nick, Color color, unsigned char id)
+Client::Client(std::string nick, Color color, unsigned short id)
 : nick(nick),
   color(color),
   id(id),
   ping(static_cast<unsigned short>(66535)) {}
 
-Client* Client::getClientWithId(std::map<unsigned char, Client*> clients, unsigned char clientId) {
+Client* Client::getClientWithId(const std::map<unsigned char, Client*> &clients, unsigned char clientId) {
 	if (clients.count(clientId) != 0) {
 		return clients.find(clientId)->second;
 	} else {
@@ -38,7 +38,7 @@ Client* Client::getClientWithId(std::map<unsigned char, Client*> clients, unsign
 	}
 }
 
-Client* Client::getClientWithNick(std::map<unsigned char, Client*> clients, std::string nick) {
+Client* Client::getClientWithNick(const std::map<unsigned char, Client*> &clients, std::string nick) {
 	for (auto &client : clients) {
 		if (client.second->getNick() == nick) {
 			return client.second;
@@ -48,7 +48,7 @@ Client* Client::getClientWithNick(std::map<unsigned char, Client*> clients, std:
 	return nullptr;
 }
 
-unsigned char Client::getIdStatic(Client *client) {
+unsigned short Client::getIdStatic(Client *client) {
 	if (client == nullptr) {
 		return 255;
 	} else {
@@ -56,7 +56,7 @@ unsigned char Client::getIdStatic(Client *client) {
 	}
 }
 
-unsigned char Client::getId() const {
+unsigned short Client::getId() const {
 	return this->id;
 }
 
@@ -25,14 +25,14 @@
 
 class Client {
 public:
-	Client(unsigned char id);
-	Client(std::string nick, Color color, unsigned char id);
+	Client(unsigned short id);
+	Client(std::string nick, Color color, unsigned short id);
 
-	static unsigned char getIdStatic(Client *client);
-	static Client* getClientWithId(std::map<unsigned char, Client*> clients, unsigned char clientId);
-	static Client* getClientWithNick(std::map<unsigned char, Client*> clients, std::string nick);
+	static unsigned short getIdStatic(Client *client);
+	static Client* getClientWithId(const std::map<unsigned char, Client*> &clients, unsigned char clientId);
+	static Client* getClientWithNick(const std::map<unsigned char, Client*> &clients, std::string nick);
 
-	unsigned char getId(void) const;
+	unsigned short getId(void) const;
 	std::string getNick(void) const;
 	Color getColor(void) const;
 	std::string getColorCode(void) const;
@@ -45,7 +45,7 @@ public:
 private:
 	std::string nick;
 	Color color;
-	unsigned char id;
+	unsigned short id;
 	unsigned short ping;
 };
 
@@ -0,0 +1,190 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "animator.h"
+
+void Animator::animateLocation(Object *object, Vector2 target, float duration) {
+	object->setAnimationTarget(target);
+	this->start(object, Property::LOCATION, Easing::EASE_OUT, object->getLocation(), target, duration);
+}
+
+// The object is already rotated, the animation turns the drawn image
+// from the old rotation to the new one
+void Animator::animateRotation(Object *object, float angle, float duration) {
+	const float offset = object->getRotationOffset() - angle;
+	this->start(object, Property::ROTATION, Easing::EASE_IN_OUT, Vector2(offset, 0.0f), Vector2(0.0f, 0.0f), duration);
+}
+
+// The object is already flipped, the old side is shown for the first half
+void Animator::animateFlip(Object *object, float duration) {
+	this->start(object, Property::FLIP, Easing::LINEAR, Vector2(0.0f, 0.0f), Vector2(1.0f, 0.0f), duration);
+}
+
+void Animator::stop(Object *object) {
+	// Removing the last animation of the object erases its slots
+	for (size_t property = 0; property < PROPERTY_COUNT; ++property) {
+		auto slots = this->slots.find(object);
+
+		if (slots != this->slots.end() && slots->second.tweens[property] != NO_TWEEN) {
+			this->remove(slots->second.tweens[property]);
+		}
+	}
+
+	object->endAnimation();
+	object->setRotationOffset(0.0f);
+	object->setFlipPhase(0.0f);
+}
+
+void Animator::clear() {
+	this->tweens.clear();
+	this->slots.clear();
+}
+
+bool Animator::isEmpty() const {
+	return this->tweens.empty();
+}
+
+void Animator::update(double deltaTime, std::vector<Object*> &moved) {
+	for (size_t i = 0; i < this->tweens.size();) {
+		Tween &tween = this->tweens.at(i);
+		tween.elapsed += deltaTime;
+
+		if (tween.elapsed >= tween.duration) {
+			this->finish(tween);
+
+			if (tween.property == Property::LOCATION) {
+				moved.push_back(tween.object);
+			}
+
+			this->remove(i);
+
+			continue;
+		}
+
+		const float t = Animator::ease(tween.easing, tween.elapsed / tween.duration);
+		const Vector2 value = tween.from + (tween.to - tween.from) * t;
+
+		switch (tween.property) {
+			case Property::LOCATION: {
+				tween.object->setLocation(value);
+				moved.push_back(tween.object);
+
+				break;
+			}
+
+			case Property::ROTATION: {
+				tween.object->setRotationOffset(value.x);
+
+				break;
+			}
+
+			case Property::FLIP: {
+				tween.object->setFlipPhase(value.x);
+
+				break;
+			}
+		}
+
+		++i;
+	}
+}
+
+void Animator::start(Object *object, Property property, Easing easing, Vector2 from, Vector2 to, float duration) {
+	Tween tween = {object, property, easing, from, to, 0.0f, duration};
+
+	auto slots = this->slots.find(object);
+	if (slots == this->slots.end()) {
+		Slots empty;
+		std::fill(empty.tweens, empty.tweens + PROPERTY_COUNT, NO_TWEEN);
+		slots = this->slots.insert(std::make_pair(object, empty)).first;
+	}
+
+	size_t &slot = slots->second.tweens[static_cast<size_t>(property)];
+
+	if (slot != NO_TWEEN) {
+		this->tweens.at(slot) = tween;
+	} else {
+		slot = this->tweens.size();
+		this->tweens.push_back(tween);
+	}
+}
+
+// Swap the last animation in place of the removed one
+void Animator::remove(size_t tween) {
+	const Tween &removed = this->tweens.at(tween);
+
+	auto slots = this->slots.find(removed.object);
+	slots->second.tweens[static_cast<size_t>(removed.property)] = NO_TWEEN;
+
+	bool running = false;
+	for (size_t property = 0; property < PROPERTY_COUNT; ++property) {
+		running = running || slots->second.tweens[property] != NO_TWEEN;
+	}
+
+	if (! running) {
+		this->slots.erase(slots);
+	}
+
+	if (tween + 1 != this->tweens.size()) {
+		this->tweens.at(tween) = this->tweens.back();
+
+		const Tween &moved = this->tweens.at(tween);
+		this->slots.at(moved.object).tweens[static_cast<size_t>(moved.property)] = tween;
+	}
+
+	this->tweens.pop_back();
+}
+
+void Animator::finish(const Tween &tween) {
+	switch (tween.property) {
+		case Property::LOCATION: {
+			tween.object->setLocation(tween.to);
+			tween.object->endAnimation();
+
+			break;
+		}
+
+		case Property::ROTATION: {
+			tween.object->setRotationOffset(0.0f);
+
+			break;
+		}
+
+		case Property::FLIP: {
+			tween.object->setFlipPhase(0.0f);
+
+			break;
+		}
+	}
+}
+
+float Animator::ease(Easing easing, float t) {
+	switch (easing) {
+		case Easing::EASE_OUT: {
+			const float u = 1.0f - t;
+			return 1.0f - u * u * u;
+		}
+
+		case Easing::EASE_IN_OUT: {
+			return t * t * (3.0f - 2.0f * t);
+		}
+
+		default: {
+			return t;
+		}
+	}
+}
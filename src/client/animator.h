@@ -0,0 +1,82 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ANIMATOR_H
+#define ANIMATOR_H
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+#include "../vector2.h"
+#include "../object.h"
+
+// Plays the animations of the objects. Only the running animations are
+// kept, so the cost of a frame depends on the number of moving objects
+// instead of all objects on the table. The running animations of each
+// object are indexed, so starting and stopping one doesn't search them.
+class Animator {
+public:
+	enum class Easing {LINEAR, EASE_OUT, EASE_IN_OUT};
+
+	// A new animation of the same kind replaces the running one of the object
+	void animateLocation(Object *object, Vector2 target, float duration);
+	void animateRotation(Object *object, float angle, float duration);
+	void animateFlip(Object *object, float duration);
+
+	// Stop the animations of an object where they are, e.g. when it is
+	// picked up or removed
+	void stop(Object *object);
+	void clear(void);
+
+	bool isEmpty(void) const;
+
+	// Advance the animations and append the objects that moved
+	void update(double deltaTime, std::vector<Object*> &moved);
+
+private:
+	enum class Property {LOCATION, ROTATION, FLIP};
+	static const size_t PROPERTY_COUNT = 3;
+	static const size_t NO_TWEEN = static_cast<size_t>(-1);
+
+	struct Tween {
+		Object *object;
+		Property property;
+		Easing easing;
+		Vector2 from;
+		Vector2 to;
+		float elapsed;
+		float duration;
+	};
+
+	// The indices of the running animations of an object by property
+	struct Slots {
+		size_t tweens[PROPERTY_COUNT];
+	};
+
+	std::vector<Tween> tweens;
+	std::unordered_map<Object*, Slots> slots;
+
+	void start(Object *object, Property property, Easing easing, Vector2 from, Vector2 to, float duration);
+	void remove(size_t tween);
+	void finish(const Tween &tween);
+
+	static float ease(Easing easing, float t);
+};
+
+#endif
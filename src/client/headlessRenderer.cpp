@@ -0,0 +1,275 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "headlessRenderer.h"
+
+HeadlessRenderer::HeadlessRenderer(Coordinates screenSize, Coordinates defaultTextureSize)
+: screenSize(screenSize),
+  screenZoom(2.0f),
+  screenLocation(0.0f, 0.0f),
+  screenRotation(0.0f),
+  defaultTextureSize(defaultTextureSize),
+  recording(false) {
+	this->clear();
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+
+}
+
+void HeadlessRenderer::setRecording(bool recording) {
+	this->recording = recording;
+}
+
+const std::vector<HeadlessRenderer::DrawCall>& HeadlessRenderer::getDrawCalls() const {
+	return this->drawCalls;
+}
+
+const HeadlessRenderer::Statistics& HeadlessRenderer::getStatistics() const {
+	return this->statistics;
+}
+
+// Forget the drawing of the previous frame
+void HeadlessRenderer::clear() {
+	this->drawCalls.clear();
+
+	this->statistics.bitmaps = 0;
+	this->statistics.batches = 0;
+	this->statistics.primitives = 0;
+	this->statistics.overlayPrimitives = 0;
+	this->statistics.overlayPasses = 0;
+	this->statistics.texts = 0;
+
+	this->overlaySize = 0;
+	this->batching = false;
+}
+
+Coordinates HeadlessRenderer::getDisplaySize() const {
+	return this->screenSize;
+}
+
+void HeadlessRenderer::resize() {
+
+}
+
+void HeadlessRenderer::setWindowTitle(std::string title, std::string icon) {
+
+}
+
+void HeadlessRenderer::updateTransformations() {
+
+}
+
+float HeadlessRenderer::getScreenScale() const {
+	return this->screenZoom / 2.0f;
+}
+
+void HeadlessRenderer::zoomScreen(float factor) {
+	if (this->screenZoom * factor > 0.1f && this->screenZoom * factor < 30.0f)
+	this->screenZoom *= factor;
+}
+
+void HeadlessRenderer::scrollScreen(Vector2 translation) {
+	this->screenLocation += translation * 2.0f / this->screenZoom;
+}
+
+void HeadlessRenderer::rotateScreen(float angle) {
+	this->screenRotation += angle;
+}
+
+void HeadlessRenderer::setScreenSize(Coordinates screenSize) {
+	this->screenSize = screenSize;
+}
+
+// The size of a texture is read from the image header if the package is available
+unsigned int HeadlessRenderer::getTexture(std::string texture) {
+	auto handle = this->textureHandles.find(texture);
+	if (handle != this->textureHandles.end()) {
+		return handle->second;
+	}
+
+	Coordinates size;
+	if (! utils::readImageSize(texture + ".png", size) && ! utils::readImageSize(texture + ".jpg", size)) {
+		size = this->defaultTextureSize;
+	}
+
+	const unsigned int newHandle = this->textureSizes.size();
+	this->textureHandles[texture] = newHandle;
+	this->textureSizes.push_back(size);
+
+	return newHandle;
+}
+
+void HeadlessRenderer::drawBitmap(unsigned int texture, Vector2 dest_location, Vector2 dest_size, float angle) {
+	this->drawBitmapTinted(texture, dest_location, dest_size, Color(1.0f, 1.0f, 1.0f, 1.0f), angle);
+}
+
+// Consecutive bitmaps of the same texture would be drawn in one batch
+void HeadlessRenderer::drawBitmapTinted(unsigned int texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle) {
+	++this->statistics.bitmaps;
+
+	if (! this->batching || texture != this->lastTexture) {
+		++this->statistics.batches;
+		this->batching = true;
+		this->lastTexture = texture;
+	}
+
+	this->record(Command::BITMAP, texture, dest_location, dest_size, color, angle);
+}
+
+void HeadlessRenderer::drawLine(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation) {
+	this->addPrimitive();
+	this->record(Command::LINE, 0, pointA, pointB, color);
+}
+
+void HeadlessRenderer::drawRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation) {
+	this->addPrimitive();
+	this->record(Command::RECTANGLE, 0, pointA, pointB, color);
+}
+
+void HeadlessRenderer::drawRectangleFilled(Vector2 pointA, Vector2 pointB, Color color, Transformation transformation) {
+	this->addPrimitive();
+	this->record(Command::RECTANGLE_FILLED, 0, pointA, pointB, color);
+}
+
+void HeadlessRenderer::drawCircle(Vector2 location, float radius, Color color, float thickness, Transformation transformation) {
+	this->addPrimitive();
+	this->record(Command::CIRCLE, 0, location, Vector2(radius, radius), color);
+}
+
+void HeadlessRenderer::drawCircleFilled(Vector2 location, float radius, Color color, Transformation transformation) {
+	this->addPrimitive();
+	this->record(Command::CIRCLE_FILLED, 0, location, Vector2(radius, radius), color);
+}
+
+// Text is drawn from the glyph bitmaps of the font
+void HeadlessRenderer::drawText(std::string text, Vector2 location, Alignment alignment) {
+	++this->statistics.texts;
+	this->batching = false;
+	this->record(Command::TEXT, 0, location, Vector2(), Color(1.0f, 1.0f, 1.0f), 0.0f, text);
+}
+
+void HeadlessRenderer::addOverlayRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation) {
+	++this->overlaySize;
+	this->record(Command::RECTANGLE, 0, pointA, pointB, color);
+}
+
+void HeadlessRenderer::addOverlayRectangleFilled(Vector2 pointA, Vector2 pointB, Color color) {
+	++this->overlaySize;
+	this->record(Command::RECTANGLE_FILLED, 0, pointA, pointB, color);
+}
+
+void HeadlessRenderer::drawOverlay() {
+	if (this->overlaySize == 0) {
+		return;
+	}
+
+	this->statistics.overlayPrimitives += this->overlaySize;
+	++this->statistics.overlayPasses;
+	this->overlaySize = 0;
+	this->batching = false;
+
+	this->record(Command::OVERLAY, 0, Vector2(), Vector2(), Color(1.0f, 1.0f, 1.0f));
+}
+
+Coordinates HeadlessRenderer::getTextureSize(unsigned int texture) {
+	return this->textureSizes.at(texture);
+}
+
+// Same transformations as in the client renderer
+void HeadlessRenderer::transformLocation(Transformation transformation, Vector2 &location) {
+	const Vector2 center(this->screenSize.x / this->screenZoom, this->screenSize.y / this->screenZoom);
+
+	if (transformation == Transformation::CAMERA) {
+		location = (location.rotate(this->screenRotation) + center + this->screenLocation) * (this->screenZoom / 2.0f);
+	} else if (transformation == Transformation::CAMERA_INVERSE) {
+		location = (location * (2.0f / this->screenZoom) - this->screenLocation - center).rotate(-this->screenRotation);
+	}
+}
+
+void HeadlessRenderer::getViewBounds(Vector2 &min, Vector2 &max) {
+	Vector2 corners[4] = {Vector2(0.0f, 0.0f), Vector2(this->screenSize.x, 0.0f),
+	                      Vector2(0.0f, this->screenSize.y), Vector2(this->screenSize.x, this->screenSize.y)};
+
+	for (int i = 0; i < 4; ++i) {
+		this->transformLocation(CAMERA_INVERSE, corners[i]);
+
+		if (i == 0) {
+			min = corners[i];
+			max = corners[i];
+		} else {
+			min = Vector2(std::min(min.x, corners[i].x), std::min(min.y, corners[i].y));
+			max = Vector2(std::max(max.x, corners[i].x), std::max(max.y, corners[i].y));
+		}
+	}
+}
+
+void HeadlessRenderer::useTransformation(Transformation transformation) {
+
+}
+
+// The hue is in degrees like in Allegro
+void HeadlessRenderer::hsvToRgb(float hue, float saturation, float value, Color *color) {
+	hue = std::fmod(hue, 360.0f);
+	if (hue < 0.0f) {
+		hue += 360.0f;
+	}
+
+	const float chroma = value * saturation;
+	const float x = chroma * (1.0f - std::abs(std::fmod(hue / 60.0f, 2.0f) - 1.0f));
+	const float m = value - chroma;
+
+	float red = 0.0f;
+	float green = 0.0f;
+	float blue = 0.0f;
+
+	switch (static_cast<int>(hue / 60.0f)) {
+		case 0:  red = chroma; green = x;      break;
+		case 1:  red = x;      green = chroma; break;
+		case 2:  green = chroma; blue = x;     break;
+		case 3:  green = x;    blue = chroma;  break;
+		case 4:  red = x;      blue = chroma;  break;
+		default: red = chroma; blue = x;       break;
+	}
+
+	color->red = red + m;
+	color->green = green + m;
+	color->blue = blue + m;
+}
+
+void HeadlessRenderer::record(Command command, unsigned int texture, Vector2 location, Vector2 size, Color color, float angle, std::string text) {
+	if (! this->recording) {
+		return;
+	}
+
+	DrawCall drawCall;
+	drawCall.command = command;
+	drawCall.texture = texture;
+	drawCall.location = location;
+	drawCall.size = size;
+	drawCall.color = color;
+	drawCall.angle = angle;
+	drawCall.text = text;
+
+	this->drawCalls.push_back(drawCall);
+}
+
+// The immediate primitives flush the held bitmap drawing
+void HeadlessRenderer::addPrimitive() {
+	++this->statistics.primitives;
+	this->batching = false;
+}
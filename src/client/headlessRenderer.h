@@ -0,0 +1,127 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HEADLESSRENDERER_H
+#define HEADLESSRENDERER_H
+
+#include <map>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "../irenderer.h"
+#include "../utils.h"
+#include "../vector2.h"
+#include "../coordinates.h"
+#include "../color.h"
+
+// A renderer without a display. It counts the drawing calls and can record
+// them, so that the drawing code can be run in benchmarks on machines
+// without graphics. The camera works like the one of the client renderer.
+class HeadlessRenderer : public IRenderer {
+public:
+	enum class Command {BITMAP, LINE, RECTANGLE, RECTANGLE_FILLED, CIRCLE, CIRCLE_FILLED, TEXT, OVERLAY};
+
+	struct DrawCall {
+		Command command;
+		unsigned int texture;
+		Vector2 location;
+		Vector2 size;     // The second point of lines and rectangles
+		Color color;
+		float angle;
+		std::string text;
+	};
+
+	struct Statistics {
+		unsigned int bitmaps;
+		unsigned int batches;       // Runs of bitmaps with the same texture
+		unsigned int primitives;    // Immediate primitives, these end the runs
+		unsigned int overlayPrimitives;
+		unsigned int overlayPasses;
+		unsigned int texts;
+	};
+
+	HeadlessRenderer(Coordinates screenSize, Coordinates defaultTextureSize = Coordinates(64, 64));
+	virtual ~HeadlessRenderer(void);
+
+	void setRecording(bool recording);
+	const std::vector<DrawCall>& getDrawCalls(void) const;
+	const Statistics& getStatistics(void) const;
+	void clear(void);
+
+	virtual Coordinates getDisplaySize(void) const;
+	virtual void resize(void);
+	virtual void setWindowTitle(std::string title, std::string icon);
+	virtual void updateTransformations(void);
+
+	virtual float getScreenScale(void) const;
+	virtual void zoomScreen(float zoom);
+	virtual void scrollScreen(Vector2 translation);
+	virtual void rotateScreen(float angle);
+	virtual void setScreenSize(Coordinates screenSize);
+
+	virtual unsigned int getTexture(std::string texture);
+
+	virtual void drawBitmap(unsigned int texture, Vector2 dest_location, Vector2 dest_size, float angle = 0);
+	virtual void drawBitmapTinted(unsigned int texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle = 0);
+
+	virtual void drawLine(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI);
+
+	virtual void drawRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI);
+	virtual void drawRectangleFilled(Vector2 pointA, Vector2 pointB, Color color, Transformation transformation = Transformation::UI);
+
+	virtual void drawCircle(Vector2 location, float radius, Color color, float thickness, Transformation transformation = Transformation::UI);
+	virtual void drawCircleFilled(Vector2 location, float radius, Color color, Transformation transformation = Transformation::UI);
+
+	virtual void drawText(std::string text, Vector2 location, Alignment alignment = Alignment::LEFT);
+
+	virtual void addOverlayRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI);
+	virtual void addOverlayRectangleFilled(Vector2 pointA, Vector2 pointB, Color color);
+	virtual void drawOverlay(void);
+
+	virtual Coordinates getTextureSize(unsigned int texture);
+
+	virtual void transformLocation(Transformation transformation, Vector2 &location);
+	virtual void getViewBounds(Vector2 &min, Vector2 &max);
+	virtual void useTransformation(Transformation transformation);
+
+	virtual void hsvToRgb(float hue, float saturation, float value, Color *color);
+
+private:
+	Coordinates screenSize;
+	float screenZoom;
+	Vector2 screenLocation;
+	float screenRotation;
+
+	Coordinates defaultTextureSize;
+	std::map<std::string, unsigned int> textureHandles;
+	std::vector<Coordinates> textureSizes;
+
+	bool recording;
+	std::vector<DrawCall> drawCalls;
+	Statistics statistics;
+
+	unsigned int overlaySize;
+	unsigned int lastTexture;
+	bool batching;
+
+	void record(Command command, unsigned int texture, Vector2 location, Vector2 size, Color color, float angle = 0.0f, std::string text = "");
+	void addPrimitive(void);
+};
+
+#endif
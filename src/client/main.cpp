@@ -73,21 +73,32 @@ void Game::catchSignal(int signal) {
 	Game::gamePtr->quit();
 }
 
-Game::Game() {
+Game::Game()
+: profiler({"network", "events", "update", "render game", "render ui", "object order", "textures"}, PROFILER_HISTORY),
+  objectIndex(OBJECT_INDEX_CELL_SIZE) {
 	this->settings = new Settings("opengamebox.cfg");
 	this->state = State::INITIALIZING;
 	this->connectionState = ConnectionState::NOT_CONNECTED;
 	this->nextFrame = true;
 	this->deltaTime = 0.0f;
+	this->fps = -1;
+	this->redrawGame = true;
+	this->redrawUI = true;
+	this->lastRenderTime = 0.0;
+	this->ticking = true;
+	this->showProfiler = false;
+	this->stampSequence = 0;
 	this->input = nullptr;
 	this->fileTransferProgress = nullptr;
-	this->localClient = net::MAX_CLIENTS;
+	this->localClient = net::NO_CLIENT;
+	this->joined = false;
+	this->spectating = false;
+	this->serverBrowser = nullptr;
+	this->network = nullptr;
 
 	this->dragging = false;
 	this->selecting = false;
 	this->keyStatus = KeyStatus();
-
-	this->loadingPackage = false;
 }
 
 Game::~Game() {
@@ -107,6 +118,12 @@ bool Game::init() {
 	al_set_physfs_file_interface();
 	PHYSFS_addToSearchPath(".", 1);
 
+	// The client is named in the trace after it has joined a game
+	const std::string traceFile = this->settings->getValue<std::string>("trace.file");
+	if (! traceFile.empty() && ! trace::open(traceFile, net::FIRST_SPECTATOR_ID, "client")) {
+		std::cerr << "Error: Could not open the trace file " << traceFile << "!" << std::endl;
+	}
+
 	// Reset frame timestamp
 	this->previousTime = al_get_time();
 
@@ -142,7 +159,9 @@ bool Game::init() {
 	// Initialize the renderer
 	this->renderer = new Renderer(Coordinates(this->settings->getValue<int>("display.width"),
 	                              this->settings->getValue<int>("display.height")),
-	                              this->settings->getValue<int>("display.multisamples"));
+	                              this->settings->getValue<int>("display.multisamples"),
+	                              this->settings->getValue<int>("display.loaderthreads"),
+	                              this->settings->getValue<bool>("display.textcache"));
 
 	// Set window title
 	this->renderer->setWindowTitle("OpenGamebox", "gfx/icon");
@@ -176,7 +195,8 @@ bool Game::init() {
 	}
 
 	this->chatWidget = new ChatWidget(Vector2(), Vector2(this->renderer->getDisplaySize().x * 2 / 5,
-								this->renderer->getDisplaySize().y/2 + 15), this->settings->getValue<float>("game.messagetime"), this->renderer->getFont());
+								this->renderer->getDisplaySize().y/2 + 15), this->settings->getValue<float>("game.messagetime"),
+								std::max(this->settings->getValue<int>("game.chathistory"), 1), this->renderer->getFont());
 
 	// Load command history
 	this->loadHistory();
@@ -184,7 +204,7 @@ bool Game::init() {
 	return true;
 }
 
-bool Game::connect(std::string address, int port) {
+bool Game::connect(std::string address, int port, bool spectate) {
 	if (this->connectionState == ConnectionState::CONNECTED) {
 		this->addMessage("You are already connected!", MessageType::ERROR);
 		return false;
@@ -193,12 +213,6 @@ bool Game::connect(std::string address, int port) {
 		this->disconnectMasterServer();
 	}
 
-	this->connection = enet_host_create (nullptr,       // Create a client host
-	                                     1,             // Only allow 1 outgoing connection
-	                                     net::CHANNELS, // Number of channels
-	                                     0,             // Unlimited downstream bandwidth
-	                                     0);            // Unlimited upstream bandwidth
-
 	if (enet_address_set_host(&(this->hostAddress), address.c_str()) < 0) {
 		this->addMessage("Unknown host!", MessageType::ERROR);
 		return false;
@@ -210,26 +224,39 @@ bool Game::connect(std::string address, int port) {
 
 	this->hostAddress.port = port;
 
-	if (this->connection == nullptr) {
+	ENetHost *connection = enet_host_create (nullptr,       // Create a client host
+	                                         1,             // Only allow 1 outgoing connection
+	                                         net::CHANNELS, // Number of channels
+	                                         0,             // Unlimited downstream bandwidth
+	                                         0);            // Unlimited upstream bandwidth
+
+	if (connection == nullptr) {
 		this->addMessage("Could not create a connection!", MessageType::ERROR);
 		return false;
 	}
 
 	// Initialize the connection
 	this->addMessage("Connecting to " + net::AddressToString(this->hostAddress) + "...");
-	host = enet_host_connect(this->connection, &this->hostAddress, 1, 0);
+	ENetPeer *host = enet_host_connect(connection, &this->hostAddress, 1, 0);
 
-	if (this->host == nullptr) {
+	if (host == nullptr) {
 		this->addMessage("Could not connect to the server!", MessageType::ERROR);
+		enet_host_destroy(connection);
 		return false;
 	}
 
 	// Set ping interval for the connection, this is only supported in ENet >= 1.3.4
 	#if ENET_VERSION >= ENET_VERSION_CREATE(1, 3, 4)
-	enet_peer_ping_interval(this->host, net::PING_INTERVAL);
+	enet_peer_ping_interval(host, net::PING_INTERVAL);
 	#endif
 
+	// The connection is serviced on its own thread from now on
+	delete this->network;
+	this->network = new NetworkThread(connection, host);
+	al_register_event_source(this->event_queue, this->network->getEventSource());
+
 	this->connectionState = ConnectionState::CONNECTING;
+	this->spectating = spectate;
 
 	return true;
 }
@@ -240,9 +267,6 @@ bool Game::connectMasterServer() {
 }
 
 bool Game::connectMasterServer(std::string address, int port) {
-	// Create a connection to the master server
-	this->connection = enet_host_create (nullptr, 1, 1, 0, 0);
-
 	if (enet_address_set_host(&(this->hostAddress), address.c_str()) < 0) {
 		this->addMessage("Unknown master server host!", MessageType::ERROR);
 		return false;
@@ -254,20 +278,28 @@ bool Game::connectMasterServer(std::string address, int port) {
 	}
 	this->hostAddress.port = port;
 
-	if (this->connection == nullptr) {
+	// Create a connection to the master server
+	ENetHost *connection = enet_host_create (nullptr, 1, 1, 0, 0);
+
+	if (connection == nullptr) {
 		this->addMessage("Could not create a connection to the master server!", MessageType::ERROR);
 		return false;
 	}
 
 	// Initialize the connection
 	this->addMessage("Connecting to " + net::AddressToString(this->hostAddress) + " (master server)...");
-	host = enet_host_connect(this->connection, &this->hostAddress, 1, 0);
+	ENetPeer *host = enet_host_connect(connection, &this->hostAddress, 1, 0);
 
-	if (this->host == nullptr) {
+	if (host == nullptr) {
 		this->addMessage("Could not connect to the master server!", MessageType::ERROR);
+		enet_host_destroy(connection);
 		return false;
 	}
 
+	delete this->network;
+	this->network = new NetworkThread(connection, host);
+	al_register_event_source(this->event_queue, this->network->getEventSource());
+
 	this->connectionState = ConnectionState::CONNECTING_MASTER_SERVER;
 
 	return true;
@@ -289,17 +321,32 @@ int Game::run() {
 
 void Game::mainLoop() {
 	while (this->state != State::TERMINATED) {
-		// Process network events
-		this->networkEvents();
-
-		// Handle local events
+		// Wait for and handle local events, the network thread wakes the loop as well
 		this->localEvents();
 
+		// Process network events
+		{
+			ProfilerTimer timer(&this->profiler, PROFILE_NETWORK);
+			this->networkEvents();
+			this->probeServers();
+		}
+
 		// Render the screen with limited FPS
 		if (this->nextFrame && al_is_event_queue_empty(this->event_queue)) {
 			this->nextFrame = false;
-			this->update();
-			this->render();
+
+			{
+				ProfilerTimer timer(&this->profiler, PROFILE_UPDATE);
+				this->update();
+			}
+
+			if (this->needsRender()) {
+				this->render();
+			}
+
+			this->profiler.endFrame();
+
+			this->setTicking(this->needsFrames());
 		}
 	}
 }
@@ -317,7 +364,7 @@ void Game::disconnect() {
 	if (this->connectionState == ConnectionState::CONNECTED
 	    || this->connectionState == ConnectionState::CONNECTING) {
 		this->addMessage("Disconnecting...");
-		enet_peer_disconnect(this->host, 0);
+		this->network->disconnect();
 
 		this->connectionState = ConnectionState::DISCONNECTING;
 	} else if (this->connectionState == ConnectionState::CONNECTED_MASTER_SERVER
@@ -330,9 +377,8 @@ void Game::disconnect() {
 }
 
 void Game::disconnectMasterServer() {
-	enet_peer_disconnect_now(this->host, 0);
-	enet_host_destroy(this->connection);
-	this->connection = nullptr;
+	delete this->network;
+	this->network = nullptr;
 
 	this->connectionState = ConnectionState::NOT_CONNECTED;
 }
@@ -342,13 +388,16 @@ void Game::dispose() {
 	this->disposeGame();
 
 	// Dispose enet
-	if (this->connection != nullptr) {
-		enet_host_destroy(this->connection);
-		this->connection = nullptr;
-	}
+	delete this->serverBrowser;
+	this->serverBrowser = nullptr;
+
+	delete this->network;
+	this->network = nullptr;
 
 	enet_deinitialize();
 
+	trace::close();
+
 	// Dispose the renderer
 	delete this->renderer;
 
@@ -367,11 +416,14 @@ void Game::dispose() {
 void Game::disposeGame() {
 	// Clear object order
 	this->objectOrder.clear();
+	this->objectIndex.clear();
 
 	// Clear selected objects
 	this->selectedObjects.clear();
 
 	// Dispose all objects
+	this->animator.clear();
+
 	for (auto &object : this->objects) {
 		delete object.second;
 	}
@@ -382,6 +434,23 @@ void Game::disposeGame() {
 		delete client.second;
 	}
 	this->clients.clear();
+	this->clientTexts.clear();
+
+	this->localClient = net::NO_CLIENT;
+	this->joined = false;
+
+	this->sentStamps.clear();
+	this->echoedStamps.clear();
+
+	// The next server is asked for the packages again
+	this->requestedPackages.clear();
+	this->downloads.clear();
+	this->updateDownloadProgress();
+
+	// The closed connection isn't serviced anymore
+	if (this->network != nullptr) {
+		this->network->stop();
+	}
 }
 
 void Game::loadHistory() {
@@ -421,7 +490,26 @@ void Game::saveHistory() {
 
 void Game::localEvents() {
 	ALLEGRO_EVENT event;
-	al_wait_for_event(event_queue, &event);
+
+	if (this->ticking) {
+		al_wait_for_event(event_queue, &event);
+	} else if (! al_wait_for_event_timed(event_queue, &event, this->getIdleTimeout())) {
+		// Nothing happened, but the idle frame is due
+		this->nextFrame = true;
+		return;
+	}
+
+	// The waiting is not counted
+	ProfilerTimer timer(&this->profiler, PROFILE_EVENTS);
+
+	// Everything but timer ticks and plain mouse movement may change the screen
+	if (event.type == ALLEGRO_EVENT_MOUSE_AXES) {
+		if (event.mouse.dz != 0 || this->dragging || this->selecting || this->keyStatus.moveScreen) {
+			this->invalidateGame();
+		}
+	} else if (event.type != ALLEGRO_EVENT_TIMER) {
+		this->invalidateGame();
+	}
 
 	if (event.type == ALLEGRO_EVENT_TIMER) {
 		this->nextFrame = true;
@@ -442,9 +530,17 @@ void Game::localEvents() {
 
 	} else if (event.type == ALLEGRO_EVENT_KEY_CHAR) {
 		if (input != nullptr) {
-			this->input->onKey(event.keyboard);
+			// Scroll the chat history by a page while the chat is open
+			if (event.keyboard.keycode == ALLEGRO_KEY_PGUP) {
+				this->chatWidget->scroll(this->chatWidget->getVisibleLineCount() - 1);
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_PGDN) {
+				this->chatWidget->scroll(1 - static_cast<int>(this->chatWidget->getVisibleLineCount()));
+			} else {
+				this->input->onKey(event.keyboard);
+			}
 		} else if (event.keyboard.keycode == ALLEGRO_KEY_ENTER) {
 			// Create a new chat input widget
+			this->chatWidget->scrollToEnd();
 			this->input = new InputBox(this, &Game::sendChat, "Chat", Vector2(2.0f, this->renderer->getDisplaySize().y / 2.0f + 20),
 										300.0f, 255, this->renderer->getFont());
 		}
@@ -452,7 +548,9 @@ void Game::localEvents() {
 		if (input == nullptr) {
 			if (event.keyboard.keycode == ALLEGRO_KEY_F10) {
 				this->quit();
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_DELETE) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_F3) {
+				this->showProfiler = ! this->showProfiler;
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_DELETE && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
 					std::string data;
 					data.push_back(net::PACKET_REMOVE);
@@ -461,11 +559,12 @@ void Game::localEvents() {
 						net::dataAppendShort(data, object->getId());
 					}
 
-					net::sendCommand(this->connection, data.c_str(), data.length());
+					this->network->send(data);
+					this->sendStamp();
 					this->selectedObjects.clear();
 					this->dragging = false;
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_SPACE) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_SPACE && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
 					std::string data;
 					data.push_back(net::PACKET_OWN);
@@ -474,7 +573,7 @@ void Game::localEvents() {
 					// objects are owned then all of the objects will be disowned.
 					bool owned = true;
  					for (auto &object : this->selectedObjects) {
-						if (! object->isOwnedBy(this->clients.find(localClient)->second)) {
+						if (! object->isOwnedBy(this->getLocalClient())) {
 							owned = false;
 
 							break;
@@ -487,15 +586,16 @@ void Game::localEvents() {
 						if (owned) {
 							object->setOwner(nullptr);
 						} else if (object->isOwnedBy(nullptr)) {
-							object->setOwner(this->clients.find(localClient)->second);
+							object->setOwner(this->getLocalClient());
 						}
 
 						net::dataAppendShort(data, object->getId());
 					}
 
-					net::sendCommand(this->connection, data.c_str(), data.length());
+					this->network->send(data);
+					this->sendStamp();
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_D) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_D && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
 					std::string data;
 					data.push_back(net::PACKET_CREATE);
@@ -506,9 +606,10 @@ void Game::localEvents() {
 						                           object->isFlipped());
 					}
 
-					net::sendCommand(this->connection, data.c_str(), data.size());
+					this->network->send(data);
+					this->sendStamp();
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_S) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_S && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
 					if (this->dragging) {
 						this->endDragging();
@@ -516,9 +617,10 @@ void Game::localEvents() {
 
 					std::string data;
 					data += net::PACKET_SHUFFLE;
-					net::sendCommand(this->connection, data.c_str(), data.length());
+					this->network->send(data);
+					this->sendStamp();
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_F) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_F && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
 					std::string data;
 					data.push_back(net::PACKET_MOVE);
@@ -528,11 +630,12 @@ void Game::localEvents() {
 						net::dataAppendShort(data, object->getId());
 						net::dataAppendVector2(data, nextLocation);
 
-						object->setAnimation(nextLocation, this->settings->getValue<float>("game.animationtime"));
+						this->animator.animateLocation(object, nextLocation, this->settings->getValue<float>("game.animationtime"));
 						nextLocation += object->getStackDelta();
 					}
 
-					net::sendCommand(this->connection, data.c_str(), data.length());
+					this->network->send(data);
+					this->sendStamp();
 				}
 			} else if (event.keyboard.keycode == ALLEGRO_KEY_PAD_PLUS) {
 				this->keyStatus.screenZoomIn = true;
@@ -552,7 +655,7 @@ void Game::localEvents() {
 				this->keyStatus.screenRotateCClockwise = true;
 			} else if (event.keyboard.keycode == ALLEGRO_KEY_W) {
 				this->keyStatus.screenRotateClockwise = true;
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_E) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_E && ! this->spectating) {
 				if(this->selectedObjects.size() > 0) {
 					for(auto &object : this->selectedObjects) {
 						std::string data;
@@ -560,10 +663,11 @@ void Game::localEvents() {
 						net::dataAppendShort(data, object->getId());
 						data.push_back(0xfc); //-4 twos complement
 
-						net::sendCommand(this->connection, data.c_str(), data.size());
+						this->network->send(data);
+						this->sendStamp();
 					}
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_R) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_R && ! this->spectating) {
 				if(this->selectedObjects.size() > 0) {
 					for(auto &object : this->selectedObjects) {
 						std::string data;
@@ -571,12 +675,13 @@ void Game::localEvents() {
 						net::dataAppendShort(data, object->getId());
 						data.push_back(0x04);
 
-						net::sendCommand(this->connection, data.c_str(), data.size());
+						this->network->send(data);
+						this->sendStamp();
 					}
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_Z) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_Z && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
-					Packet packet(this->connection);
+					Packet packet;
 					packet.writeHeader(Packet::Header::SCALE);
 					for(auto &object : this->selectedObjects) {
 						if(object->getScale() - 0.1f > 0) {
@@ -584,17 +689,19 @@ void Game::localEvents() {
 							packet.writeFloat(object->getScale() - 0.1f);
 						}
 					}
-					packet.send();
+					this->network->send(packet);
+					this->sendStamp();
 				}
-			} else if (event.keyboard.keycode == ALLEGRO_KEY_X) {
+			} else if (event.keyboard.keycode == ALLEGRO_KEY_X && ! this->spectating) {
 				if (this->selectedObjects.size() > 0) {
-					Packet packet(this->connection);
+					Packet packet;
 					packet.writeHeader(Packet::Header::SCALE);
 					for(auto &object : this->selectedObjects) {
 						packet.writeShort(object->getId());
 						packet.writeFloat(object->getScale() + 0.1f);
 					}
-					packet.send();
+					this->network->send(packet);
+					this->sendStamp();
 				}
 			}
 		}
@@ -620,7 +727,7 @@ void Game::localEvents() {
 				this->keyStatus.snappingToGrid = false;
 			}
 		}
-	} else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && event.mouse.button == 1) {
+	} else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && event.mouse.button == 1 && ! this->spectating) {
 		Vector2 location(event.mouse.x, event.mouse.y);
 		this->renderer->transformLocation(IRenderer::CAMERA_INVERSE, location);
 
@@ -636,7 +743,7 @@ void Game::localEvents() {
 			for (auto objectIterator = this->objectOrder.rbegin(); objectIterator != this->objectOrder.rend(); ++objectIterator) {
 				Object *object = *objectIterator;
 
-				if (object->isSelectedBy(nullptr) && (object->isOwnedBy(nullptr) || object->isOwnedBy(this->clients.find(localClient)->second))
+				if (object->isSelectedBy(nullptr) && (object->isOwnedBy(nullptr) || object->isOwnedBy(this->getLocalClient()))
 				    && object->testLocation(location)) {
 					std::set<Object*> visited;
 					this->selectedObjects = object->getObjectsAbove(visited);
@@ -650,19 +757,26 @@ void Game::localEvents() {
 
 						net::removeObject(this->objectOrder, objectA);
 						this->objectOrder.push_back(objectA);
+						this->objectIndex.raise(objectA);
 					}
 
 					break;
 				}
 			}
 
-			net::sendCommand(this->connection, data.c_str(), data.length());
+			this->network->send(data);
+			this->sendStamp();
 		}
 
 		if (!this->selectedObjects.empty()) {
 			for (auto &object : this->selectedObjects) {
 				if (object->testLocation(location)) {
 					this->dragging = true;
+
+					for (auto &selected : this->selectedObjects) {
+						this->animator.stop(selected);
+					}
+
 					this->draggingStart = this->selectedObjects.front()->getLocation() - location;
 
 					break;
@@ -676,7 +790,7 @@ void Game::localEvents() {
 			this->selecting = true;
 			this->selectingStart = location;
 		}
-	} else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && event.mouse.button == 2) {
+	} else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && event.mouse.button == 2 && ! this->spectating) {
 		if (this->dragging) {
 			std::string data;
 			data.push_back(net::PACKET_FLIP);
@@ -695,12 +809,17 @@ void Game::localEvents() {
 			data += ! flipped;
 
 			for (auto &object : this->selectedObjects) {
+				if (object->isFlipped() == flipped) {
+					this->animator.animateFlip(object, this->settings->getValue<float>("game.animationtime"));
+				}
+
 				object->setFlipped(! flipped);
 
 				net::dataAppendShort(data, object->getId());
 			}
 
-			net::sendCommand(this->connection, data.c_str(), data.length());
+			this->network->send(data);
+			this->sendStamp();
 		}
 	} else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_DOWN && event.mouse.button == 3) {
 		this->keyStatus.moveScreen = true;
@@ -732,34 +851,43 @@ void Game::localEvents() {
 				higher.y = location.y;
 			}
 
-			for (auto &object : this->objects) {
-				if ((object.second->isOwnedBy(this->clients.find(localClient)->second) || object.second->isSelectedBy(this->clients.find(localClient)->second))
-						|| (object.second->isOwnedBy(nullptr) && object.second->isSelectedBy(nullptr))) {
-					std::vector<Vector2> corners = object.second->getCorners();
-					bool selected = true;
+			// Only the objects in the rectangle are candidates, they are then
+			// tested in batches at their current locations
+			std::vector<Object*> candidates;
+			this->objectIndex.query(lower, higher, candidates);
+			this->objectBoxes.clear();
 
-					for (auto &corner : corners) {
-						if (!(lower.x < corner.x && corner.x < higher.x && lower.y < corner.y && corner.y < higher.y)) {
-							selected = false;
-							break;
-						}
-					}
+			Vector2 center;
+			Vector2 halfSize;
+			Vector2 axis;
 
-					if (selected) {
-						object.second->select(this->clients.find(localClient)->second);
-						this->selectedObjects.push_back(object.second);
-					}
+			for (auto &object : candidates) {
+				object->getBox(center, halfSize, axis);
+				this->objectBoxes.add(object->getLocation(), halfSize, axis);
+			}
+
+			this->boxQueryResult.clear();
+			this->objectBoxes.queryContained(lower, higher, this->boxQueryResult);
+
+			for (auto &index : this->boxQueryResult) {
+				Object *object = candidates.at(index);
+
+				if ((object->isOwnedBy(this->getLocalClient()) || object->isSelectedBy(this->getLocalClient()))
+						|| (object->isOwnedBy(nullptr) && object->isSelectedBy(nullptr))) {
+					object->select(this->getLocalClient());
+					this->selectedObjects.push_back(object);
 				}
 			}
 
-			Packet packet(this->connection);
+			Packet packet;
 			packet.writeHeader(Packet::Header::SELECT);
 
 			for (auto &object : this->selectedObjects) {
 				packet.writeShort(object->getId());
 			}
 
-			packet.send();
+			this->network->send(packet);
+			this->sendStamp();
 		}
 	} else if (event.type == ALLEGRO_EVENT_MOUSE_BUTTON_UP && event.mouse.button == 3) {
 		this->keyStatus.moveScreen = false;
@@ -804,6 +932,7 @@ void Game::localEvents() {
 				}
 
 				object->setLocation(destination);
+				this->objectIndex.update(object);
 			}
 		} else if (this->keyStatus.moveScreen && (event.mouse.dx != 0 || event.mouse.dy != 0)) {
 			Vector2 location(event.mouse.x, event.mouse.y);
@@ -824,20 +953,64 @@ void Game::endDragging() {
 		net::dataAppendShort(data, object->getId());
 		net::dataAppendVector2(data, object->getLocation());
 
-		object->setAnimation(object->getLocation(), 0.0f);
+		this->animator.stop(object);
 	}
 
-	net::sendCommand(this->connection, data.c_str(), data.length());
+	trace::instant("drop", "input", {{"objects", static_cast<double>(this->selectedObjects.size())}});
+	this->network->send(data);
+	this->sendStamp();
 
 	this->dragging = false;
 }
 
+// Follow an object command with a stamp, which the server echoes to
+// everybody with the time the command arrived and was passed on
+void Game::sendStamp() {
+	if (! this->settings->getValue<bool>("network.latencystamps")) {
+		return;
+	}
+
+	Packet packet;
+	packet.writeHeader(Packet::Header::STAMP);
+	packet.writeShort(this->stampSequence);
+	this->network->send(packet);
+
+	this->sentStamps[this->stampSequence] = utils::getTime();
+	++this->stampSequence;
+}
+
+// The server times are compared to the local ones only after the clocks are synchronized
+void Game::receiveStamp(Packet &packet) {
+	const unsigned char client = packet.readByte();
+	const unsigned short sequence = packet.readShort();
+	const double receiveTime = packet.readTime();
+	const double sendTime = packet.readTime();
+
+	if (client == this->localClient) {
+		std::map<unsigned short, double>::iterator stamp = this->sentStamps.find(sequence);
+
+		if (stamp != this->sentStamps.end()) {
+			if (trace::isClockSynchronized()) {
+				this->latencies["input to server"].add((receiveTime - stamp->second - trace::getClockOffset()) * 1000.0);
+			}
+
+			this->echoedStamps.push_back(stamp->second);
+			this->sentStamps.erase(stamp);
+		}
+	} else if (trace::isClockSynchronized()) {
+		this->latencies["server to peers"].add((trace::getServerTime() - sendTime) * 1000.0);
+	}
+}
+
 void Game::networkEvents() {
-	ENetEvent event;
+	NetworkThread::Event event;
+
+	// The events are already waiting in the queue, the network thread has serviced the connection
+	while (this->connectionState != ConnectionState::NOT_CONNECTED && this->network->receive(event)) {
+		this->invalidateGame();
 
-	while (this->connectionState != ConnectionState::NOT_CONNECTED && enet_host_service(this->connection, &event, 0) > 0) {
 		switch (event.type) {
-			case ENET_EVENT_TYPE_CONNECT: {
+			case NetworkThread::Event::Type::CONNECT: {
 				if (this->connectionState == ConnectionState::CONNECTING) {
 					this->addMessage("Connected! Please enter your nick.");
 
@@ -854,14 +1027,14 @@ void Game::networkEvents() {
 
 			}
 
-			case ENET_EVENT_TYPE_RECEIVE: {
+			case NetworkThread::Event::Type::RECEIVE: {
 				if (this->connectionState == ConnectionState::CONNECTED_MASTER_SERVER) {
 					this->receivePacket(event);
 				} else if (this->connectionState == ConnectionState::CONNECTED) {
-					if (this->localClient != net::MAX_CLIENTS || event.packet->data[0] == net::PACKET_HANDSHAKE ||
-					    event.packet->data[0] == net::PACKET_NICK_TAKEN) {
+					if (this->joined || event.header == Packet::Header::HANDSHAKE ||
+					    event.header == Packet::Header::NICK_TAKEN || event.header == Packet::Header::CHAT) {
 						this->receivePacket(event);
-					} else if (event.packet->data[0] == net::PACKET_MS_QUERY) {
+					} else if (event.header == Packet::Header::MS_QUERY) {
 						this->addMessage("Can't use a master server as a game server!", MessageType::ERROR);
 						this->disconnectMasterServer();
 					}
@@ -872,7 +1045,7 @@ void Game::networkEvents() {
 				break;
 			}
 
-			case ENET_EVENT_TYPE_DISCONNECT: {
+			case NetworkThread::Event::Type::DISCONNECT: {
 				this->addMessage("Disconnected from the server.");
 				this->connectionState = ConnectionState::NOT_CONNECTED;
 
@@ -884,23 +1057,30 @@ void Game::networkEvents() {
 
 				break;
 			}
-
-			case ENET_EVENT_TYPE_NONE: {
-				break;
-			}
 		}
 	}
 }
 
-void Game::receivePacket(ENetEvent event) {
+void Game::receivePacket(NetworkThread::Event event) {
 	Packet packet(event.packet);
 
+	trace::Scope scope([&] { return "receive " + Packet::getHeaderName(event.header); }, "network");
+	scope.setArgument("bytes", event.packet->dataLength);
+
 	try {
 		switch (packet.readHeader()) {
 			case Packet::Header::HANDSHAKE: {
-				if (event.packet->dataLength >= 2 && event.packet->dataLength <= 2 + 34*(net::MAX_CLIENTS - 1)) {
-					// Store the received client id
+				if (event.packet->dataLength >= 2 && event.packet->dataLength <= 2 + 34*(net::MAX_PLAYERS - 1)) {
+					// Store the received client id, spectators don't get one
 					this->localClient = event.packet->data[1];
+					this->joined = true;
+
+					trace::setProcess(this->localClient == net::NO_CLIENT ? net::FIRST_SPECTATOR_ID : 1 + this->localClient,
+					                  this->localClient == net::NO_CLIENT ? "spectator" : "player " + utils::toString(this->localClient));
+
+					if (this->localClient == net::NO_CLIENT) {
+						this->addMessage("You are spectating the game.");
+					}
 
 					// Update the local client list
 					size_t i = 2;
@@ -932,6 +1112,7 @@ void Game::receivePacket(ENetEvent event) {
 					Client *client = new Client(std::string(reinterpret_cast<char*>(event.packet->data + 2), event.packet->dataLength - 2),
 												Color(this->renderer, event.packet->data[1]), event.packet->data[1]);
 					this->clients[event.packet->data[1]] = client;
+					this->clientTexts.erase(event.packet->data[1]);
 
 					this->addMessage(client->getColoredNick() + " has joined the server!");
 				}
@@ -957,6 +1138,7 @@ void Game::receivePacket(ENetEvent event) {
 					// Clear the client information
 					delete this->clients.find(event.packet->data[1])->second;
 					this->clients.erase(event.packet->data[1]);
+					this->clientTexts.erase(event.packet->data[1]);
 				}
 
 				break;
@@ -997,14 +1179,6 @@ void Game::receivePacket(ENetEvent event) {
 
 						ObjectClass *objectClass = this->objectClassManager.getObjectClass(objectData.at(0), objectData.at(1), &(this->missingPackages));
 
-						if (!this->loadingPackage && !this->missingPackages.empty()){
-							this->loadingPackage = true;
-							Packet reply(this->connection);
-							reply.writeHeader(Packet::Header::PACKAGE_MISSING);
-							reply.writeString(*this->missingPackages.begin());
-							reply.send();
-						}
-
 						Object *object = new Object(objectClass, objectData.at(2), objId, location);
 						object->initForClient(this->renderer);
 						object->select(selected);
@@ -1014,12 +1188,14 @@ void Game::receivePacket(ENetEvent event) {
 
 						this->objects.insert(std::pair<unsigned int, Object*>(objId, object));
 						this->objectOrder.push_back(object);
+						this->objectIndex.update(object);
 
 						amount++;
 
 						i += 15 + length;
 					}
 
+					this->requestMissingPackages();
 					this->checkObjectOrder();
 
 					if (event.packet->data[1] != 255) {
@@ -1047,12 +1223,14 @@ void Game::receivePacket(ENetEvent event) {
 
 						if (this->settings->getValue<float>("game.animationtime") == 0) {
 							object->setLocation(location);
+							this->objectIndex.update(object);
 						} else {
-							object->setAnimation(location, this->settings->getValue<float>("game.animationtime"));
+							this->animator.animateLocation(object, location, this->settings->getValue<float>("game.animationtime"));
 						}
 
 						net::removeObject(this->objectOrder, object);
 						this->objectOrder.push_back(object);
+						this->objectIndex.raise(object);
 
 						lastObject = object;
 						i += 10;
@@ -1110,6 +1288,8 @@ void Game::receivePacket(ENetEvent event) {
 
 						Object *object = this->objects.find(objId)->second;
 						net::removeObject(this->objectOrder, object);
+						this->objectIndex.remove(object);
+						this->animator.stop(object);
 						this->objects.erase(objId);
 
 						lastObject = object->getName();
@@ -1146,6 +1326,11 @@ void Game::receivePacket(ENetEvent event) {
 						unsigned short objId = net::bytesToShort(event.packet->data + i);
 
 						Object *object = this->objects.find(objId)->second;
+
+						if (object->isFlipped() != flipped) {
+							this->animator.animateFlip(object, this->settings->getValue<float>("game.animationtime"));
+						}
+
 						object->setFlipped(flipped);
 
 						lastObject = object;
@@ -1213,6 +1398,8 @@ void Game::receivePacket(ENetEvent event) {
 				unsigned short objId = net::bytesToShort(event.packet->data + 1);
 				char rotation = event.packet->data[3];
 				this->objects[objId]->rotate(rotation * utils::PI / 8);
+				this->objectIndex.update(this->objects[objId]);
+				this->animator.animateRotation(this->objects[objId], rotation * utils::PI / 8, this->settings->getValue<float>("game.animationtime"));
 
 				break;
 			}
@@ -1232,19 +1419,46 @@ void Game::receivePacket(ENetEvent event) {
 				break;
 			}
 
+			case Packet::Header::STAMP: {
+				this->receiveStamp(packet);
+
+				break;
+			}
+
+			case Packet::Header::TIME: {
+				trace::addClockSample(packet.readTime(), this->network->getRoundTripTime() / 1000.0);
+
+				break;
+			}
+
 			case Packet::Header::MS_QUERY: {
 				if (this->connectionState == ConnectionState::CONNECTED_MASTER_SERVER) {
-					this->addMessage("Server list:");
+					unsigned short total = packet.readShort();
+					unsigned short nextCursor = packet.readShort();
+
+					std::ostringstream header;
+					header << "Server list (" << total << " servers):";
+					this->addMessage(header.str());
+
+					// The servers are listed as their probes finish
+					delete this->serverBrowser;
+					this->serverBrowser = new ServerBrowser(this->settings->getValue<int>("network.probeconcurrency"),
+					                                        this->settings->getValue<float>("network.probetimeout"));
 
 					while (!packet.eof()) {
 						std::string address = packet.readString();
 						unsigned short port = packet.readShort();
 						std::string name = packet.readString();
 						unsigned short players = packet.readShort();
+						unsigned short slots = packet.readShort();
+
+						this->serverBrowser->addServer(address, port, name, players, slots);
+					}
 
-						std::ostringstream server;
-						server << "\"" << name << "\" @ " << address << ":" << port << " (" << players << " players)";
-						this->addMessage(server.str());
+					if (nextCursor != 0) {
+						std::ostringstream more;
+						more << "Use -page " << nextCursor / this->serverQuery.pageSize + 1 << " to see more servers.";
+						this->addMessage(more.str());
 					}
 
 					this->disconnectMasterServer();
@@ -1253,79 +1467,70 @@ void Game::receivePacket(ENetEvent event) {
 				break;
 			}
 
+			case Packet::Header::PACKAGE_MISSING: {
+				// The package isn't requested again from this server
+				this->addMessage("The server doesn't have the package " + packet.readString() + "!", MessageType::WARNING);
+
+				break;
+			}
+
 			case Packet::Header::FILE_TRANSFER: {
+				const unsigned char transfer = packet.readByte();
+				scope.setArgument("transfer", transfer);
+
 				if (packet.readShort() == 0) {
-					this->loadingfile.size = packet.readInt();
-					this->loadingfile.data = new char[this->loadingfile.size];
-					this->loadingfile.name = packet.readString();
-					this->loadingfile.received = 0;
-					this->loadingfile.startTime = this->previousTime;
+					File &file = this->downloads[transfer];
+					file.size = packet.readInt();
+					file.name = packet.readString();
+					file.data.assign(file.size, '\0');
+					file.received = 0;
+					file.startTime = this->previousTime;
 
 					std::ostringstream message("");
-					message << "Downloading package " << this->loadingfile.name << " (" << net::getPrettyFileSize(this->loadingfile.size) << ").";
+					message << "Downloading package " << file.name << " (" << net::getPrettyFileSize(file.size) << ").";
 					this->addMessage(message.str());
 
-					const Vector2 progressBarSize(300.0f, 50.0f);
-					this->fileTransferProgress = new ProgressBar(Vector2(this->renderer->getDisplaySize().x / 2.0f - progressBarSize.x / 2.0f,
-					                                                     this->renderer->getDisplaySize().y / 2.0f - progressBarSize.y / 2.0f),
-					                                             progressBarSize, 0.0f);
+					if (this->fileTransferProgress == nullptr) {
+						const Vector2 progressBarSize(300.0f, 50.0f);
+						this->fileTransferProgress = new ProgressBar(Vector2(this->renderer->getDisplaySize().x / 2.0f - progressBarSize.x / 2.0f,
+						                                                     this->renderer->getDisplaySize().y / 2.0f - progressBarSize.y / 2.0f),
+						                                             progressBarSize, 0.0f);
+					}
 				} else {
+					std::map<unsigned char, File>::iterator download = this->downloads.find(transfer);
+					if (download == this->downloads.end()) {
+						throw PacketException("Unknown file transfer.");
+					}
+
 					int ofset = packet.readInt();
 					int size = packet.readInt();
 					std::string tmp = packet.readString();
 
-					for (unsigned int i = 0; i < tmp.size(); i++) {
-						this->loadingfile.data[ofset + i] = tmp.at(i);
+					scope.setArgument("offset", ofset);
+
+					if (size < 0 || static_cast<size_t>(size) != tmp.size()) {
+						throw PacketException("File transfer piece of a wrong size.");
 					}
 
-					this->loadingfile.received += size;
+					if (ofset < 0 || ofset + tmp.size() > download->second.data.size()) {
+						throw PacketException("File transfer out of bounds.");
+					}
 
-					this->fileTransferProgress->setProgress(1.0f * this->loadingfile.received / this->loadingfile.size);
+					// Only the bytes actually written count towards the package
+					download->second.data.replace(ofset, tmp.size(), tmp);
+					download->second.received += tmp.size();
 				}
 
-				if (this->loadingfile.size == this->loadingfile.received) {
-					delete this->fileTransferProgress;
-					this->fileTransferProgress = nullptr;
-
-					std::ofstream file;
-					file.open("data/" + this->loadingfile.name + ".zip", std::ios::out | std::ios::binary);
-					file << std::string(this->loadingfile.data, this->loadingfile.size);
-					file.close();
-
-					const double time = this->previousTime - this->loadingfile.startTime;
-					std::ostringstream message("");
-					message << "Downloaded package " << this->loadingfile.name << " in " << time << " seconds.";
-					this->addMessage(message.str());
+				std::map<unsigned char, File>::iterator download = this->downloads.find(transfer);
+				if (download != this->downloads.end() && download->second.received >= download->second.size) {
+					const File file = download->second;
+					this->downloads.erase(download);
 
-					PHYSFS_addToSearchPath(("data/" + this->loadingfile.name + ".zip").c_str(), 1);
+					this->finishDownload(file);
+				}
 
-					for (auto &object : this->objects) {
-						if (object.second->getObjectClass()->getPackage() == this->loadingfile.name) {
-							object.second->initForClient(this->renderer);
-						}
-					}
+				this->updateDownloadProgress();
 
-					std::string name = this->loadingfile.name;
-
-					this->loadingPackage = false;
-					this->missingPackages.erase(this->loadingfile.name);
-					delete this->loadingfile.data;
-					this->loadingfile.name = "";
-					this->loadingfile.size = 0;
-					this->loadingfile.received = 0;
-
-					if (!this->missingPackages.empty()) {
-						this->loadingPackage = true;
-						Packet reply(this->connection);
-						reply.writeHeader(Packet::Header::PACKAGE_MISSING);
-						reply.writeString(*this->missingPackages.begin());
-						reply.send();
-					}
-
-					for (auto &objClass : this->objectClassManager.getClassesInPackage(name)) {
-						objClass->loadSettings();
-					}
-				}
 				break;
 			}
 
@@ -1333,6 +1538,7 @@ void Game::receivePacket(ENetEvent event) {
 				this->objectOrder.clear();
 				while (!packet.eof()) {
 					this->objectOrder.push_back(this->objects.find(packet.readShort())->second);
+					this->objectIndex.raise(this->objectOrder.back());
 				}
 
 				this->checkObjectOrder();
@@ -1346,6 +1552,7 @@ void Game::receivePacket(ENetEvent event) {
 						unsigned short id = packet.readShort();
 						float scale = packet.readFloat();
 						this->objects.at(id)->setScale(scale);
+						this->objectIndex.update(this->objects.at(id));
 					}
 				}
 				break;
@@ -1357,7 +1564,7 @@ void Game::receivePacket(ENetEvent event) {
 		}
 	} catch (PacketException &e) {
 		this->addMessage("Received an invalid packet from "
-		                 + net::AddressToString(event.peer->address)
+		                 + net::AddressToString(this->hostAddress)
 		                 + ": \"" + e.what() + "\"", MessageType::DEBUG);
 
 		if (this->connectionState == ConnectionState::CONNECTED_MASTER_SERVER) {
@@ -1384,6 +1591,8 @@ void Game::addMessage(std::string text, MessageType type) {
 	message.time = previousTime;
 	std::cout << message.message << std::endl;
 	this->chatWidget->addMessage(message);
+
+	this->invalidateUI();
 }
 
 // Send a chat packet
@@ -1399,7 +1608,7 @@ void Game::sendChat(std::string text) {
 			data.push_back(net::PACKET_CHAT);
 			data.append(text);
 
-			net::sendCommand(this->connection, data.c_str(), data.length());
+			this->network->send(data);
 		} else {
 			this->addMessage("You are not connected to a server!", MessageType::ERROR);
 		}
@@ -1421,9 +1630,15 @@ size_t Game::getSentMessageCount() {
 void Game::chatCommand(std::string commandstr) {
 	std::vector<std::string> parameters = utils::splitString(commandstr, ' ');
 
+	// The server refuses the game commands of the spectators
+	if (this->spectating && (parameters.at(0) == "create" || parameters.at(0) == "dflush" || parameters.at(0) == "roll")) {
+		this->addMessage("Spectators can't use /" + parameters.at(0) + "!", MessageType::ERROR);
+		return;
+	}
+
 	if (parameters.at(0) == "quit") {
 		this->quit();
-	} else if (parameters.at(0) == "connect") {
+	} else if (parameters.at(0) == "connect" || parameters.at(0) == "spectate") {
 		if (parameters.size() == 1) {
 			this->addMessage("Usage: /" + parameters.at(0) + " host [port]");
 			return;
@@ -1438,7 +1653,7 @@ void Game::chatCommand(std::string commandstr) {
 			port = this->settings->getValue<int>("network.port");
 		}
 
-		this->connect(parameters[1], port);
+		this->connect(parameters[1], port, parameters.at(0) == "spectate");
 	} else if (parameters.at(0) == "disconnect") {
 		this->disconnect();
 	} else if (parameters.at(0) == "login") {
@@ -1454,11 +1669,18 @@ void Game::chatCommand(std::string commandstr) {
 			this->addMessage("Usage: /" + parameters.at(0) + " player");
 		}
 	} else if (parameters.at(0) == "servers") {
-		if (this->connectionState == ConnectionState::NOT_CONNECTED) {
+		if (! this->parseServerQuery(parameters)) {
+			this->addMessage("Usage: /" + parameters.at(0) + " [-name text] [-players min max] [-free slots] [-package name]"
+			                 + " [-sort name|players|free] [-desc] [-page number]");
+		} else if (this->connectionState == ConnectionState::NOT_CONNECTED) {
 			this->connectMasterServer();
 		} else {
 			this->addMessage("You are already connected to a server. Please disconnect first.");
 		}
+	} else if (parameters.at(0) == "profile") {
+		this->profileCommand(parameters);
+	} else if (parameters.at(0) == "latency") {
+		this->latencyCommand(parameters);
 	} else if (parameters.at(0) == "load") {
 		if (parameters.size() == 2) {
 			this->loadScript(parameters.at(1));
@@ -1482,7 +1704,8 @@ void Game::chatCommand(std::string commandstr) {
 			} else {
 				this->addMessage("Usage: /" + parameters.at(0) + " object [x y] [flipped]");
 			}
-			net::sendCommand(this->connection, data.c_str(), data.size());
+			this->network->send(data);
+			this->sendStamp();
 		} else if (parameters.size() == 4 || parameters.size() == 5) {
 			Vector2 location;
 			{
@@ -1502,7 +1725,8 @@ void Game::chatCommand(std::string commandstr) {
 			} else {
 				this->addMessage("Usage: /" + parameters.at(0) + " object [x y] [flipped]");
 			}
-			net::sendCommand(this->connection, data.c_str(), data.size());
+			this->network->send(data);
+			this->sendStamp();
 		} else {
 			this->addMessage("Usage: /" + parameters.at(0) + " object [x y] [flipped]");
 		}
@@ -1551,7 +1775,8 @@ void Game::chatCommand(std::string commandstr) {
 			}
 		}
 
-		net::sendCommand(this->connection, data.c_str(), data.size());
+		this->network->send(data);
+		this->sendStamp();
 		this->dCreateBuffer.clear();
 	} else if (parameters.at(0) == "roll") {
 		if (parameters.size() <= 3) {
@@ -1565,7 +1790,7 @@ void Game::chatCommand(std::string commandstr) {
 			std::string data;
 			data.push_back(net::PACKET_ROLL);
 			net::dataAppendShort(data, maxValue);
-			net::sendCommand(this->connection, data.c_str(), data.length());
+			this->network->send(data);
 		} else {
 			this->addMessage("Usage: /" + parameters.at(0) + " [max value]");
 		}
@@ -1573,10 +1798,8 @@ void Game::chatCommand(std::string commandstr) {
 		if (parameters.size() == 2 && this->connectionState == ConnectionState::CONNECTED){
 			PHYSFS_delete(("data/" + parameters.at(1) + ".zip").c_str());
 			this->missingPackages.insert(parameters.at(1));
-			Packet packet(this->connection);
-			packet.writeHeader(Packet::Header::PACKAGE_MISSING);
-			packet.writeString(parameters.at(1));
-			packet.send();
+			this->requestedPackages.erase(parameters.at(1));
+			this->requestMissingPackages();
 
 		}
 	} else {
@@ -1584,11 +1807,79 @@ void Game::chatCommand(std::string commandstr) {
 	}
 }
 
+// Ask for every missing package that hasn't been asked for yet in one packet
+void Game::requestMissingPackages() {
+	Packet packet;
+	packet.writeHeader(Packet::Header::PACKAGE_MISSING);
+
+	bool requested = false;
+	for (auto &package : this->missingPackages) {
+		if (this->requestedPackages.insert(package).second) {
+			packet.writeString(package);
+			requested = true;
+		}
+	}
+
+	if (requested) {
+		this->network->send(packet);
+	}
+}
+
+void Game::finishDownload(const File &download) {
+	std::ofstream file;
+	file.open("data/" + download.name + ".zip", std::ios::out | std::ios::binary);
+	file << download.data;
+	file.close();
+
+	const double time = this->previousTime - download.startTime;
+	std::ostringstream message("");
+	message << "Downloaded package " << download.name << " in " << time << " seconds.";
+	this->addMessage(message.str());
+
+	PHYSFS_addToSearchPath(("data/" + download.name + ".zip").c_str(), 1);
+
+	for (auto &object : this->objects) {
+		if (object.second->getObjectClass()->getPackage() == download.name) {
+			object.second->initForClient(this->renderer);
+			this->objectIndex.update(object.second);
+		}
+	}
+
+	this->missingPackages.erase(download.name);
+	this->requestedPackages.erase(download.name);
+
+	for (auto &objClass : this->objectClassManager.getClassesInPackage(download.name)) {
+		objClass->loadSettings();
+	}
+}
+
+// Show the total progress of all downloads
+void Game::updateDownloadProgress() {
+	if (this->downloads.empty()) {
+		delete this->fileTransferProgress;
+		this->fileTransferProgress = nullptr;
+
+		return;
+	}
+
+	int size = 0;
+	int received = 0;
+
+	for (auto &download : this->downloads) {
+		size += download.second.size;
+		received += download.second.received;
+	}
+
+	if (this->fileTransferProgress != nullptr && size > 0) {
+		this->fileTransferProgress->setProgress(1.0f * received / size);
+	}
+}
+
 void Game::login(std::string password) {
-	Packet packet(this->connection);
+	Packet packet;
 	packet.writeHeader(Packet::Header::LOGIN);
 	packet.writeString(password);
-	packet.send();
+	this->network->send(packet);
 }
 
 void Game::kick(std::string nick) {
@@ -1598,10 +1889,10 @@ void Game::kick(std::string nick) {
 		return;
 	}
 
-	Packet packet(this->connection);
+	Packet packet;
 	packet.writeHeader(Packet::Header::KICK);
 	packet.writeByte(target->getId());
-	packet.send();
+	this->network->send(packet);
 }
 
 void Game::loadScript(std::string script) {
@@ -1681,8 +1972,27 @@ std::string Game::createObject(std::string objectId, Vector2 location, bool flip
 }
 
 void Game::checkObjectOrder() {
+	ProfilerTimer timer(&this->profiler, PROFILE_OBJECT_ORDER);
+
+	// Test every object against the objects above it in batches
+	this->objectBoxes.clear();
+	this->objectBoxes.reserve(this->objectOrder.size());
+
+	Vector2 center;
+	Vector2 halfSize;
+	Vector2 axis;
+
 	for (auto &object : this->objectOrder) {
-		object->checkIfUnder(this->objectOrder);
+		object->getBox(center, halfSize, axis);
+		this->objectBoxes.add(center, halfSize, axis);
+	}
+
+	for (size_t i = 0; i < this->objectOrder.size(); ++i) {
+		this->objectOrder.at(i)->getBox(center, halfSize, axis);
+
+		this->boxQueryResult.clear();
+		this->objectBoxes.queryOverlaps(center, halfSize, axis, i + 1, this->boxQueryResult);
+		this->objectOrder.at(i)->checkIfUnder(this->objectOrder, this->boxQueryResult);
 	}
 }
 
@@ -1691,25 +2001,117 @@ void Game::askNick() {
 								225.0f, 16, this->renderer->getFont());
 }
 
+// Returns nullptr when spectating
+Client* Game::getLocalClient() const {
+	return Client::getClientWithId(this->clients, this->localClient);
+}
+
 void Game::identifyToServer(std::string nick) {
 	delete input;
 	this->input = nullptr;
 
 	if (nick.length() > 0) {
 		std::string data;
-		data.push_back(net::PACKET_HANDSHAKE);
+		if (this->spectating) {
+			data.push_back(static_cast<char>(Packet::Header::SPECTATE));
+		} else {
+			data.push_back(net::PACKET_HANDSHAKE);
+		}
+
 		data.append(nick, 0, 16); // Limit nick to 16 characters
 
-		net::sendCommand(this->connection, data.c_str(), data.length());
+		this->network->send(data);
 	} else {
 		this->askNick();
 	}
 }
 
+// List the probed servers with their latencies as they finish
+void Game::probeServers() {
+	if (this->serverBrowser == nullptr) {
+		return;
+	}
+
+	this->serverBrowser->update();
+
+	ServerBrowser::Result result;
+	while (this->serverBrowser->getResult(result)) {
+		std::ostringstream server;
+		server << "\"" << result.name << "\" @ " << result.address << ":" << result.port << " (" << result.players;
+		if (result.slots != 65535) {
+			server << "/" << result.slots;
+		}
+		server << " players, ";
+
+		if (result.responded) {
+			server << static_cast<int>(result.latency * 1000.0 + 0.5) << " ms)";
+		} else {
+			server << "^f00no response^fff)";
+		}
+
+		this->addMessage(server.str());
+	}
+
+	if (this->serverBrowser->isDone()) {
+		delete this->serverBrowser;
+		this->serverBrowser = nullptr;
+	}
+}
+
 void Game::queryMasterServer() {
-	Packet packet(this->connection);
+	Packet packet;
 	packet.writeHeader(Packet::Header::MS_QUERY);
-	packet.send();
+	this->serverQuery.write(packet);
+	this->network->send(packet);
+}
+
+// Read the server list filters from the parameters of the /servers command
+bool Game::parseServerQuery(const std::vector<std::string> &parameters) {
+	ServerQuery query;
+	unsigned int page = 1;
+
+	for (size_t i = 1; i < parameters.size(); ++i) {
+		const std::string &option = parameters.at(i);
+		const size_t values = parameters.size() - i - 1;
+
+		if (option == "-name" && values >= 1) {
+			query.name = parameters.at(++i);
+		} else if (option == "-players" && values >= 2) {
+			std::istringstream(parameters.at(++i)) >> query.minPlayers;
+			std::istringstream(parameters.at(++i)) >> query.maxPlayers;
+		} else if (option == "-free" && values >= 1) {
+			std::istringstream(parameters.at(++i)) >> query.minFreeSlots;
+		} else if (option == "-package" && values >= 1) {
+			query.packages.push_back(parameters.at(++i));
+		} else if (option == "-sort" && values >= 1) {
+			const std::string &sort = parameters.at(++i);
+
+			if (sort == "name") {
+				query.sort = ServerQuery::Sort::NAME;
+			} else if (sort == "players") {
+				query.sort = ServerQuery::Sort::PLAYERS;
+			} else if (sort == "free") {
+				query.sort = ServerQuery::Sort::FREE_SLOTS;
+			} else {
+				return false;
+			}
+		} else if (option == "-desc") {
+			query.descending = true;
+		} else if (option == "-page" && values >= 1) {
+			std::istringstream(parameters.at(++i)) >> page;
+
+			if (page == 0) {
+				return false;
+			}
+		} else {
+			return false;
+		}
+	}
+
+	query.cursor = (page - 1) * query.pageSize;
+	this->serverQuery = query;
+
+	return true;
 }
 
 void Game::update() {
@@ -1717,9 +2119,25 @@ void Game::update() {
 	this->deltaTime = al_get_time() - this->previousTime;
 	this->previousTime = al_get_time();
 
-	// Animate objects
-	for (auto &object : this->objectOrder) {
-		object->animate(this->deltaTime);
+	// Finish the loading of textures within the time budget of the frame
+	{
+		ProfilerTimer timer(&this->profiler, PROFILE_TEXTURES);
+
+		if (this->renderer->uploadTextures(this->settings->getValue<float>("display.texturebudget") / 1000.0)) {
+			this->invalidateGame();
+		}
+	}
+
+	// Animate objects, only the moved ones need to be indexed again
+	if (! this->animator.isEmpty()) {
+		this->invalidateGame();
+	}
+
+	this->movedObjects.clear();
+	this->animator.update(this->deltaTime, this->movedObjects);
+
+	for (auto &object : this->movedObjects) {
+		this->objectIndex.update(object);
 	}
 
 	// Translate, rotate and scale the screen
@@ -1751,23 +2169,119 @@ void Game::update() {
 	}
 
 	this->renderer->updateTransformations();
+
+	if (this->isMovingScreen()) {
+		this->invalidateGame();
+	}
+
+	// The profiler graph changes every frame
+	if (this->showProfiler) {
+		this->invalidateUI();
+	}
+}
+
+void Game::invalidateGame() {
+	this->redrawGame = true;
+	this->invalidateUI();
+}
+
+// A change resumes the frame timer, and the first frame is rendered right away
+void Game::invalidateUI() {
+	this->redrawUI = true;
+
+	if (! this->ticking) {
+		this->setTicking(true);
+		this->nextFrame = true;
+	}
+}
+
+// Whether the next frame may differ even without events
+bool Game::needsFrames() const {
+	return ! this->settings->getValue<bool>("display.renderonchange") || this->redrawGame || this->redrawUI
+	       || ! this->animator.isEmpty() || this->isMovingScreen() || this->dragging || this->selecting
+	       || this->showProfiler || this->serverBrowser != nullptr || this->renderer->isLoadingTextures()
+	       || (this->network != nullptr && this->network->needsPolling());
+}
+
+bool Game::isMovingScreen() const {
+	return this->keyStatus.screenZoomIn || this->keyStatus.screenZoomOut || this->keyStatus.screenMoveLeft
+	       || this->keyStatus.screenMoveRight || this->keyStatus.screenMoveUp || this->keyStatus.screenMoveDown
+	       || this->keyStatus.screenRotateClockwise || this->keyStatus.screenRotateCClockwise;
+}
+
+void Game::setTicking(bool ticking) {
+	if (ticking == this->ticking) {
+		return;
+	}
+
+	if (ticking) {
+		al_start_timer(this->timer);
+	} else {
+		al_stop_timer(this->timer);
+	}
+
+	this->ticking = ticking;
+}
+
+// Time until the next idle frame
+double Game::getIdleTimeout() const {
+	const double timeout = this->lastRenderTime + this->settings->getValue<float>("display.idleinterval") - al_get_time();
+	return std::max(timeout, 0.001);
+}
+
+// Idle frames are still rendered now and then for the chat messages that expire
+bool Game::needsRender() const {
+	return ! this->settings->getValue<bool>("display.renderonchange") || this->redrawGame || this->redrawUI
+	       || al_get_time() >= this->lastRenderTime + this->settings->getValue<float>("display.idleinterval");
 }
 
 void Game::render() {
-	// Clear the screen
-	al_clear_to_color(al_map_rgb_f(0.1f, 0.1f, 0.1f));
+	if (this->settings->getValue<bool>("display.cachegamelayer")) {
+		if (this->redrawGame) {
+			ProfilerTimer timer(&this->profiler, PROFILE_RENDER_GAME);
+
+			this->renderer->beginLayer();
+			al_clear_to_color(al_map_rgb_f(0.1f, 0.1f, 0.1f));
+			al_hold_bitmap_drawing(true);
+			this->renderGame();
+			al_hold_bitmap_drawing(false);
+			this->renderer->endLayer();
+		}
 
-	// Begin render
-	al_hold_bitmap_drawing(true);
+		this->renderer->drawLayer();
+		al_hold_bitmap_drawing(true);
+	} else {
+		// Clear the screen
+		al_clear_to_color(al_map_rgb_f(0.1f, 0.1f, 0.1f));
+
+		// Begin render
+		al_hold_bitmap_drawing(true);
 
-	this->renderGame();
-	this->renderUI();
+		ProfilerTimer timer(&this->profiler, PROFILE_RENDER_GAME);
+		this->renderGame();
+	}
+
+	{
+		ProfilerTimer timer(&this->profiler, PROFILE_RENDER_UI);
+		this->renderUI();
+	}
 
 	// Finish render
 	al_hold_bitmap_drawing(false);
 
 	// Draw the rendering
 	al_flip_display();
+
+	this->redrawGame = false;
+	this->redrawUI = false;
+	this->lastRenderTime = al_get_time();
+
+	// The echoed commands are now on the screen
+	for (auto &time : this->echoedStamps) {
+		this->latencies["input to render"].add((utils::getTime() - time) * 1000.0);
+	}
+
+	this->echoedStamps.clear();
 }
 
 void Game::renderGame() {
@@ -1776,9 +2290,109 @@ void Game::renderGame() {
 	// Draw the table area
 	this->renderer->drawRectangle(Vector2(-net::MAX_FLOAT, -net::MAX_FLOAT), Vector2(net::MAX_FLOAT, net::MAX_FLOAT), Color(1.0f, 1.0f, 1.0f, 1.0f), 5.0f);
 
-	for (auto &object : this->objectOrder) {
-		object->draw(this->renderer, this->clients.find(this->localClient)->second);
+	Client *localClient = this->getLocalClient();
+
+	// Only draw the objects on the screen
+	Vector2 min;
+	Vector2 max;
+	this->renderer->getViewBounds(min, max);
+	this->objectIndex.query(min, max, this->visibleObjects);
+
+	this->buildPiles(this->renderer->getScreenScale());
+
+	for (size_t i = 0; i < this->visibleObjects.size(); ++i) {
+		Object *object = this->visibleObjects[i];
+
+		// A pile of tiny objects is drawn once in the average colour of its objects
+		if (this->tinyObjects.count(object) != 0) {
+			Pile &pile = this->piles[this->findPile(i)];
+
+			if (pile.count > 1) {
+				if (! pile.drawn) {
+					const float count = pile.count;
+					this->renderer->addOverlayRectangleFilled(pile.min, pile.max, Color(pile.color.red / count, pile.color.green / count,
+					                                          pile.color.blue / count, pile.color.alpha / count));
+					pile.drawn = true;
+				}
+
+				object->drawMarkers(this->renderer);
+				continue;
+			}
+		}
+
+		object->draw(this->renderer, localClient);
 	}
+
+	this->renderer->drawOverlay();
+}
+
+// Join the visible objects smaller than IMPOSTOR_SIZE pixels with the tiny
+// objects on top of them and sum up the bounds and colours of the piles
+void Game::buildPiles(float screenScale) {
+	Client *localClient = this->getLocalClient();
+
+	this->tinyObjects.clear();
+	this->pileParents.resize(this->visibleObjects.size());
+
+	for (size_t i = 0; i < this->visibleObjects.size(); ++i) {
+		this->pileParents[i] = i;
+
+		Vector2 objectMin;
+		Vector2 objectMax;
+		this->visibleObjects[i]->getBounds(objectMin, objectMax);
+
+		if ((objectMax.x - objectMin.x) * screenScale < IMPOSTOR_SIZE && (objectMax.y - objectMin.y) * screenScale < IMPOSTOR_SIZE) {
+			this->tinyObjects[this->visibleObjects[i]] = i;
+		}
+	}
+
+	for (auto &tiny : this->tinyObjects) {
+		for (auto &above : tiny.first->getObjectsDirectlyAbove()) {
+			auto tinyAbove = this->tinyObjects.find(above);
+
+			if (tinyAbove != this->tinyObjects.end()) {
+				this->pileParents[this->findPile(tiny.second)] = this->findPile(tinyAbove->second);
+			}
+		}
+	}
+
+	Pile empty;
+	empty.color = Color(0.0f, 0.0f, 0.0f, 0.0f);
+	empty.count = 0;
+	empty.drawn = false;
+	this->piles.assign(this->visibleObjects.size(), empty);
+
+	for (auto &tiny : this->tinyObjects) {
+		Pile &pile = this->piles[this->findPile(tiny.second)];
+
+		Vector2 objectMin;
+		Vector2 objectMax;
+		tiny.first->getBounds(objectMin, objectMax);
+
+		if (pile.count == 0) {
+			pile.min = objectMin;
+			pile.max = objectMax;
+		} else {
+			pile.min = Vector2(std::min(pile.min.x, objectMin.x), std::min(pile.min.y, objectMin.y));
+			pile.max = Vector2(std::max(pile.max.x, objectMax.x), std::max(pile.max.y, objectMax.y));
+		}
+
+		const Color color = this->renderer->getTextureColor(tiny.first->getDrawnTexture(localClient));
+		pile.color.red += color.red;
+		pile.color.green += color.green;
+		pile.color.blue += color.blue;
+		pile.color.alpha += color.alpha;
+		++pile.count;
+	}
+}
+
+size_t Game::findPile(size_t object) {
+	while (this->pileParents[object] != object) {
+		this->pileParents[object] = this->pileParents[this->pileParents[object]];
+		object = this->pileParents[object];
+	}
+
+	return object;
 }
 
 void Game::renderUI() {
@@ -1794,14 +2408,20 @@ void Game::renderUI() {
 
 	int i = 0;
 	for (auto &client : this->clients) {
-		std::string text;
-		if (client.second->getPing() != 65535) {
-			text = client.second->getColoredNick() + " (" + utils::toString(client.second->getPing()) + " ms)";
-		} else {
-			text = client.second->getColoredNick();
+		auto clientText = this->clientTexts.find(client.first);
+		if (clientText == this->clientTexts.end() || clientText->second.ping != client.second->getPing()) {
+			ClientText &newText = this->clientTexts[client.first];
+			newText.ping = client.second->getPing();
+			if (newText.ping != 65535) {
+				newText.text = client.second->getColoredNick() + " (" + utils::toString(newText.ping) + " ms)";
+			} else {
+				newText.text = client.second->getColoredNick();
+			}
+
+			clientText = this->clientTexts.find(client.first);
 		}
 
-		this->renderer->drawText(text, Vector2(0.0f, i * 20.0f));
+		this->renderer->drawText(clientText->second.text, Vector2(0.0f, i * 20.0f));
 
 		++i;
 	}
@@ -1812,8 +2432,13 @@ void Game::renderUI() {
 		this->chatWidget->draw(this->renderer, false);
 	}
 
-	this->renderer->drawText("FPS: " + utils::toString( static_cast<int>(1.0 / this->deltaTime + 0.25)),
-	                         Vector2(0.0f, this->renderer->getDisplaySize().y - 20.0f));
+	const int fps = static_cast<int>(1.0 / this->deltaTime + 0.25);
+	if (fps != this->fps) {
+		this->fps = fps;
+		this->fpsText = "FPS: " + utils::toString(fps);
+	}
+
+	this->renderer->drawText(this->fpsText, Vector2(0.0f, this->renderer->getDisplaySize().y - 20.0f));
 
 	for (auto &widget : this->widgets) {
 		widget->draw(this->renderer);
@@ -1825,5 +2450,96 @@ void Game::renderUI() {
 
 	if (this->fileTransferProgress != nullptr) {
 		this->fileTransferProgress->draw(this->renderer);
+
+		// The progress of each package below the total
+		Vector2 location = this->fileTransferProgress->getLocation() + Vector2(0.0f, this->fileTransferProgress->getSize().y + 5.0f);
+
+		for (auto &download : this->downloads) {
+			const int percent = static_cast<int>(100.0 * download.second.received / download.second.size);
+			this->renderer->drawText(download.second.name + ": " + utils::toString(percent) + " %", location);
+			location.y += 20.0f;
+		}
+	}
+
+	if (this->showProfiler) {
+		this->renderProfiler();
+	}
+}
+
+// Draw the time of each section in the latest frames as stacked bars
+void Game::renderProfiler() {
+	const Coordinates displaySize = this->renderer->getDisplaySize();
+	const float left = displaySize.x - 2.0f * PROFILER_HISTORY - 10.0f;
+	const float bottom = 10.0f + 20.0f * PROFILER_GRAPH_SCALE;
+
+	for (size_t age = 0; age < this->profiler.getHistorySize(); ++age) {
+		const float x = left + 2.0f * (PROFILER_HISTORY - 1 - age);
+		float y = bottom;
+
+		for (unsigned int section = 0; section < this->profiler.getSectionCount(); ++section) {
+			const float height = this->profiler.getFrameTime(section, age) * PROFILER_GRAPH_SCALE;
+
+			if (height > 0.0f) {
+				this->renderer->addOverlayRectangleFilled(Vector2(x, y - height), Vector2(x + 2.0f, y), Color(this->renderer, section));
+				y -= height;
+			}
+		}
+	}
+
+	// The time available for a frame
+	const float frameTime = 1000.0f / this->settings->getValue<float>("display.fpslimit");
+	this->renderer->addOverlayRectangleFilled(Vector2(left, bottom - frameTime * PROFILER_GRAPH_SCALE),
+	                                          Vector2(left + 2.0f * PROFILER_HISTORY, bottom - frameTime * PROFILER_GRAPH_SCALE + 1.0f),
+	                                          Color(1.0f, 1.0f, 1.0f, 0.5f));
+
+	this->renderer->drawOverlay();
+
+	for (unsigned int section = 0; section < this->profiler.getSectionCount(); ++section) {
+		const Histogram &histogram = this->profiler.getHistogram(section);
+
+		std::ostringstream text;
+		text << std::fixed << std::setprecision(2) << Color(this->renderer, section).encodedString()
+		     << this->profiler.getSectionName(section) << "^fff: " << histogram.getMean() << " ms, 99% "
+		     << histogram.getPercentile(99.0) << " ms";
+
+		this->renderer->drawText(text.str(), Vector2(left, bottom + 5.0f + section * 20.0f));
+	}
+}
+
+void Game::profileCommand(const std::vector<std::string> &parameters) {
+	if (parameters.size() == 1) {
+		for (unsigned int section = 0; section < this->profiler.getSectionCount(); ++section) {
+			this->addMessage(this->profiler.getSectionName(section) + ": " + this->profiler.getHistogram(section).getSummary());
+		}
+	} else if (parameters.at(1) == "save" && parameters.size() <= 3) {
+		const std::string file = parameters.size() == 3 ? parameters.at(2) : "profile.csv";
+
+		if (this->profiler.writeCsv(file)) {
+			this->addMessage("Saved the latest " + utils::toString(this->profiler.getHistorySize()) + " frames to " + file + ".");
+		} else {
+			this->addMessage("Could not write " + file + ".", MessageType::ERROR);
+		}
+	} else if (parameters.at(1) == "reset" && parameters.size() == 2) {
+		this->profiler.clear();
+		this->addMessage("The profiler was reset.");
+	} else {
+		this->addMessage("Usage: /" + parameters.at(0) + " [save [file]|reset]");
+	}
+}
+
+void Game::latencyCommand(const std::vector<std::string> &parameters) {
+	if (parameters.size() == 1) {
+		if (this->latencies.empty()) {
+			this->addMessage("No latencies measured yet. Set network.latencystamps to measure them.");
+		}
+
+		for (auto &latency : this->latencies) {
+			this->addMessage(latency.first + ": " + latency.second.getSummary());
+		}
+	} else if (parameters.at(1) == "reset" && parameters.size() == 2) {
+		this->latencies.clear();
+		this->addMessage("The latencies were reset.");
+	} else {
+		this->addMessage("Usage: /" + parameters.at(0) + " [reset]");
 	}
 }
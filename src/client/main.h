@@ -22,10 +22,12 @@
 
 #include <list>
 #include <set>
+#include <unordered_map>
 #include <string>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <iomanip>
 #include <iterator>
 #include <csignal>
 #include <tuple>
@@ -42,10 +44,19 @@
 #include "../objectClassManager.h"
 #include "../objectClass.h"
 #include "renderer.h"
+#include "serverBrowser.h"
+#include "spatialIndex.h"
+#include "animator.h"
+#include "networkThread.h"
+#include "../boxArray.h"
 #include "widgets/inputBox.h"
 #include "widgets/textarea.h"
 #include "widgets/chatwidget.h"
 #include "../settings.h"
+#include "../serverQuery.h"
+#include "../histogram.h"
+#include "../profiler.h"
+#include "../trace.h"
 
 class ProgressBar;
 
@@ -55,6 +66,16 @@ class ProgressBar;
 const std::string HISTORY_FILE = "history.txt";
 const size_t HISTORY_SIZE = 20;
 
+// The cell size of the object index in table units
+const float OBJECT_INDEX_CELL_SIZE = 256.0f;
+
+// Piles of objects smaller than this on the screen (in pixels) are drawn as a single quad
+const float IMPOSTOR_SIZE = 4.0f;
+
+// The number of frames in the profiler graph and its scale in pixels per millisecond
+const size_t PROFILER_HISTORY = 240;
+const float PROFILER_GRAPH_SCALE = 6.0f;
+
 int main(int argc, char **argv);
 
 class Game {
@@ -66,7 +87,7 @@ public:
 	static Game *gamePtr;
 	static void catchSignal(int signal);
 
-	bool connect(std::string address, int port);
+	bool connect(std::string address, int port, bool spectate = false);
 	bool connectMasterServer(void);
 	bool connectMasterServer(std::string address, int port);
 
@@ -83,8 +104,7 @@ private:
 	ALLEGRO_TIMER *timer;
 
 	ENetAddress hostAddress;
-	ENetHost *connection;
-	ENetPeer *host;
+	NetworkThread *network;
 
 	Renderer *renderer;
 
@@ -100,23 +120,80 @@ private:
 	double previousTime;
 	double deltaTime;
 
+	// Frames are rendered only when something has changed. The game layer
+	// is drawn from a cache if only the UI has changed.
+	bool redrawGame;
+	bool redrawUI;
+	double lastRenderTime;
+
+	// The frame timer runs only while the screen changes by itself, the
+	// main loop sleeps in the event queue otherwise
+	bool ticking;
+
+	// The profiled sections of the main loop
+	enum ProfilerSection {PROFILE_NETWORK, PROFILE_EVENTS, PROFILE_UPDATE, PROFILE_RENDER_GAME, PROFILE_RENDER_UI,
+	                      PROFILE_OBJECT_ORDER, PROFILE_TEXTURES};
+	Profiler profiler;
+	bool showProfiler;
+
+	// End-to-end latencies of the object commands by the server echoes of the stamps
+	unsigned short stampSequence;
+	std::map<unsigned short, double> sentStamps; // Local send times by sequence number
+	std::vector<double> echoedStamps;            // Send times of the echoes not rendered yet
+	std::map<std::string, Histogram> latencies;
+
 	ObjectClassManager objectClassManager;
 
-	bool loadingPackage;
+	// The missing packages are requested all at once and downloaded at the
+	// same time, each of them is loaded as soon as it has been received
 	std::set<std::string> missingPackages;
+	std::set<std::string> requestedPackages;
 	struct File {
 		std::string name;
 		int size;
-		char* data;
+		std::string data;
 		int received;
 		double startTime;
 	};
-	File loadingfile;
+	std::map<unsigned char, File> downloads; // By transfer id
 
 	std::map<unsigned short, Object*> objects;
 	std::vector<Object*> objectOrder;
+	SpatialIndex objectIndex;
+	std::vector<Object*> visibleObjects;
+
+	// The visible objects that are too small to be drawn one by one are
+	// joined into piles with the objects on top of them
+	struct Pile {
+		Vector2 min;
+		Vector2 max;
+		Color color; // Sum of the colours of the objects
+		unsigned int count;
+		bool drawn;
+	};
+	std::unordered_map<Object*, size_t> tinyObjects; // Index in the visible objects
+	std::vector<size_t> pileParents;
+	std::vector<Pile> piles;
+	BoxArray objectBoxes;
+	Animator animator;
+	std::vector<Object*> movedObjects;
+	std::vector<size_t> boxQueryResult;
 	std::map<unsigned char, Client*> clients;
+
+	// The UI texts are rebuilt only when the values in them change
+	struct ClientText {
+		unsigned short ping;
+		std::string text;
+	};
+	std::map<unsigned char, ClientText> clientTexts; // By client id
+	int fps;
+	std::string fpsText;
+	ServerQuery serverQuery;
+	ServerBrowser *serverBrowser;
+
 	unsigned char localClient;
+	bool joined;
+	bool spectating; // Spectators can watch and chat but not touch the objects
 
 	ChatWidget *chatWidget;
 
@@ -163,7 +240,9 @@ private:
 	void endDragging(void);
 
 	void networkEvents(void);
-	void receivePacket(ENetEvent event);
+	void receivePacket(NetworkThread::Event event);
+	void sendStamp(void);
+	void receiveStamp(Packet &packet);
 
 	enum class MessageType {NORMAL, ERROR, WARNING, DEBUG};
 	void addMessage(std::string message, MessageType type = MessageType::NORMAL);
@@ -176,13 +255,33 @@ private:
 	std::string createObject(std::string object, Vector2 location = Vector2(0.0f, 0.0f), bool flipped = false);
 	void checkObjectOrder(void);
 
+	void requestMissingPackages(void);
+	void finishDownload(const File &file);
+	void updateDownloadProgress(void);
+
 	void askNick(void);
+	Client* getLocalClient(void) const;
 	void queryMasterServer(void);
+	void probeServers(void);
+	bool parseServerQuery(const std::vector<std::string> &parameters);
+
+	void invalidateGame(void);
+	void invalidateUI(void);
+	bool needsRender(void) const;
+	bool needsFrames(void) const;
+	bool isMovingScreen(void) const;
+	void setTicking(bool ticking);
+	double getIdleTimeout(void) const;
 
 	void update(void);
 	void render(void);
 	void renderGame(void);
+	void buildPiles(float screenScale);
+	size_t findPile(size_t object);
 	void renderUI(void);
+	void renderProfiler(void);
+	void profileCommand(const std::vector<std::string> &parameters);
+	void latencyCommand(const std::vector<std::string> &parameters);
 };
 
 #endif
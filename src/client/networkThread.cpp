@@ -0,0 +1,361 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "networkThread.h"
+
+NetworkThread::NetworkThread(ENetHost *host, ENetPeer *peer)
+: host(host),
+  peer(peer),
+  wakePending(false),
+  signalled(false),
+  outgoing(QUEUE_CAPACITY),
+  incoming(QUEUE_CAPACITY),
+  roundTripTime(peer->roundTripTime) {
+	al_init_user_event_source(&this->eventSource);
+
+	this->openWakeSocket();
+
+	this->thread = al_create_thread(&NetworkThread::run, this);
+
+	// Without a thread the host is serviced whenever the events are polled
+	if (this->thread != nullptr) {
+		al_start_thread(this->thread);
+	}
+}
+
+NetworkThread::~NetworkThread() {
+	this->stop();
+
+	al_destroy_user_event_source(&this->eventSource);
+}
+
+void NetworkThread::stop() {
+	if (this->host == nullptr) {
+		return;
+	}
+
+	if (this->thread != nullptr) {
+		al_set_thread_should_stop(this->thread);
+		this->wake();
+
+		al_join_thread(this->thread, nullptr);
+		al_destroy_thread(this->thread);
+		this->thread = nullptr;
+	}
+
+	if (this->wakeSocket != ENET_SOCKET_NULL) {
+		enet_socket_destroy(this->wakeSocket);
+		this->wakeSocket = ENET_SOCKET_NULL;
+	}
+
+	this->dropQueues();
+
+	enet_peer_disconnect_now(this->peer, 0);
+	enet_host_destroy(this->host);
+	this->host = nullptr;
+	this->peer = nullptr;
+}
+
+void NetworkThread::send(const std::string &data, bool isReliable) {
+	Command command;
+	command.type = Command::Type::SEND;
+	command.packet = enet_packet_create(data.data(), data.length(), isReliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+
+	this->queueCommand(command);
+}
+
+void NetworkThread::send(const Packet &packet) {
+	Command command;
+	command.type = Command::Type::SEND;
+	command.packet = packet.createENetPacket();
+
+	this->queueCommand(command);
+}
+
+void NetworkThread::disconnect() {
+	Command command;
+	command.type = Command::Type::DISCONNECT;
+	command.packet = nullptr;
+
+	this->queueCommand(command);
+}
+
+bool NetworkThread::receive(Event &event) {
+	if (this->host == nullptr) {
+		return false;
+	}
+
+	this->flushCommands();
+
+	if (this->thread == nullptr) {
+		this->service(0);
+	}
+
+	if (this->incoming.pop(event)) {
+		return true;
+	}
+
+	// The events posted after clearing the flag are announced again
+	this->signalled.store(false);
+	return this->incoming.pop(event);
+}
+
+ALLEGRO_EVENT_SOURCE* NetworkThread::getEventSource() {
+	return &this->eventSource;
+}
+
+bool NetworkThread::needsPolling() const {
+	return this->thread == nullptr && this->host != nullptr;
+}
+
+unsigned int NetworkThread::getRoundTripTime() const {
+	return this->roundTripTime.load(std::memory_order_relaxed);
+}
+
+// Called from the main thread
+void NetworkThread::queueCommand(const Command &command) {
+	if (this->host == nullptr) {
+		if (command.packet != nullptr) {
+			enet_packet_destroy(command.packet);
+		}
+
+		return;
+	}
+
+	this->flushCommands();
+
+	// Keep the commands in order behind the earlier overflow
+	if (! this->pendingCommands.empty() || ! this->outgoing.push(command)) {
+		this->pendingCommands.push_back(command);
+	}
+
+	this->wake();
+}
+
+void NetworkThread::flushCommands() {
+	const size_t overflow = this->pendingCommands.size();
+
+	while (! this->pendingCommands.empty() && this->outgoing.push(this->pendingCommands.front())) {
+		this->pendingCommands.pop_front();
+	}
+
+	if (this->pendingCommands.size() < overflow) {
+		this->wake();
+	}
+}
+
+// Called from the network thread
+// Returns whether the main thread can receive the event already
+bool NetworkThread::postEvent(const Event &event) {
+	this->flushEvents();
+
+	if (! this->pendingEvents.empty() || ! this->incoming.push(event)) {
+		this->pendingEvents.push_back(event);
+		return false;
+	}
+
+	return true;
+}
+
+void NetworkThread::flushEvents() {
+	while (! this->pendingEvents.empty() && this->incoming.push(this->pendingEvents.front())) {
+		this->pendingEvents.pop_front();
+	}
+}
+
+void NetworkThread::service(unsigned int timeout) {
+	Command command;
+	while (this->outgoing.pop(command)) {
+		if (command.type == Command::Type::SEND) {
+			// ENet takes the packet only if the peer is connected
+			if (enet_peer_send(this->peer, 0, command.packet) < 0) {
+				enet_packet_destroy(command.packet);
+			}
+		} else if (command.type == Command::Type::DISCONNECT) {
+			enet_peer_disconnect(this->peer, 0);
+		}
+	}
+
+	bool posted = false;
+
+	ENetEvent enetEvent;
+	int result = enet_host_service(this->host, &enetEvent, timeout);
+
+	while (result > 0) {
+		Event event;
+		event.header = Packet::Header::HANDSHAKE;
+		event.packet = nullptr;
+
+		switch (enetEvent.type) {
+			case ENET_EVENT_TYPE_CONNECT: {
+				event.type = Event::Type::CONNECT;
+				posted |= this->postEvent(event);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_RECEIVE: {
+				// Empty packets have nothing to handle
+				if (enetEvent.packet->dataLength == 0) {
+					enet_packet_destroy(enetEvent.packet);
+					break;
+				}
+
+				event.type = Event::Type::RECEIVE;
+				event.header = static_cast<Packet::Header>(enetEvent.packet->data[0]);
+				event.packet = enetEvent.packet;
+				posted |= this->postEvent(event);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_DISCONNECT: {
+				event.type = Event::Type::DISCONNECT;
+				posted |= this->postEvent(event);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_NONE: {
+				break;
+			}
+		}
+
+		result = enet_host_check_events(this->host, &enetEvent);
+	}
+
+	// Retry the overflow even if nothing new arrived
+	const size_t overflow = this->pendingEvents.size();
+	this->flushEvents();
+	posted |= this->pendingEvents.size() < overflow;
+
+	// Wake up the main thread once for all the events it hasn't seen yet
+	if (posted && ! this->signalled.exchange(true)) {
+		ALLEGRO_EVENT event;
+		event.user.type = EVENT_TYPE;
+		al_emit_user_event(&this->eventSource, &event, nullptr);
+	}
+
+	this->roundTripTime.store(this->peer->roundTripTime, std::memory_order_relaxed);
+}
+
+// Bind a socket on the loopback interface for waking up the thread
+void NetworkThread::openWakeSocket() {
+	this->wakeSocket = ENET_SOCKET_NULL;
+
+#if ENET_VERSION >= ENET_VERSION_CREATE(1, 3, 4)
+	ENetSocket socket = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+	if (socket == ENET_SOCKET_NULL) {
+		return;
+	}
+
+	ENetAddress address;
+	address.port = ENET_PORT_ANY;
+
+	if (enet_address_set_host(&address, "127.0.0.1") < 0 || enet_socket_bind(socket, &address) < 0
+	    || enet_socket_get_address(socket, &this->wakeAddress) < 0
+	    || enet_socket_set_option(socket, ENET_SOCKOPT_NONBLOCK, 1) < 0) {
+		enet_socket_destroy(socket);
+		return;
+	}
+
+	this->wakeSocket = socket;
+#endif
+}
+
+// Called from the main thread
+void NetworkThread::wake() {
+	if (this->wakeSocket == ENET_SOCKET_NULL || this->wakePending.exchange(true)) {
+		return;
+	}
+
+	char data = 0;
+	ENetBuffer buffer;
+	buffer.data = &data;
+	buffer.dataLength = 1;
+
+	enet_socket_send(this->wakeSocket, &this->wakeAddress, &buffer, 1);
+}
+
+// Called from the network thread
+// Sleep until a packet arrives, the main thread wakes this thread up or the timeout passes
+void NetworkThread::wait(unsigned int timeout) {
+	ENetSocketSet sockets;
+	ENET_SOCKETSET_EMPTY(sockets);
+	ENET_SOCKETSET_ADD(sockets, this->host->socket);
+	ENET_SOCKETSET_ADD(sockets, this->wakeSocket);
+
+	enet_socketset_select(std::max(this->host->socket, this->wakeSocket), &sockets, nullptr, timeout);
+
+	// The commands queued before a wake-up datagram are sent on the next service
+	this->wakePending.store(false);
+
+	char data;
+	ENetBuffer buffer;
+	buffer.data = &data;
+	buffer.dataLength = 1;
+
+	while (enet_socket_receive(this->wakeSocket, nullptr, &buffer, 1) > 0) { }
+}
+
+void NetworkThread::dropQueues() {
+	// Destroy the packets that never made it through the queues
+	Command command;
+	while (this->outgoing.pop(command)) {
+		if (command.packet != nullptr) {
+			enet_packet_destroy(command.packet);
+		}
+	}
+
+	for (auto &pending : this->pendingCommands) {
+		if (pending.packet != nullptr) {
+			enet_packet_destroy(pending.packet);
+		}
+	}
+	this->pendingCommands.clear();
+
+	Event event;
+	while (this->incoming.pop(event)) {
+		if (event.packet != nullptr) {
+			enet_packet_destroy(event.packet);
+		}
+	}
+
+	for (auto &pending : this->pendingEvents) {
+		if (pending.packet != nullptr) {
+			enet_packet_destroy(pending.packet);
+		}
+	}
+	this->pendingEvents.clear();
+}
+
+void* NetworkThread::run(ALLEGRO_THREAD *thread, void *argument) {
+	NetworkThread *network = static_cast<NetworkThread*>(argument);
+
+	while (! al_get_thread_should_stop(thread)) {
+		if (network->wakeSocket == ENET_SOCKET_NULL) {
+			network->service(POLL_TIMEOUT);
+		} else {
+			network->service(0);
+
+			// The events that didn't fit in the queue are retried soon
+			network->wait(network->pendingEvents.empty() ? SERVICE_TIMEOUT : POLL_TIMEOUT);
+		}
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,126 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NETWORKTHREAD_H
+#define NETWORKTHREAD_H
+
+#include <atomic>
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#include <enet/enet.h>
+#include <allegro5/allegro.h>
+
+#include "../packet.h"
+#include "spscQueue.h"
+
+// Services the connection of an ENet host on its own thread, so that the
+// acknowledgements and pings are answered even while a frame is being
+// rendered. The packets are handed to and from the main thread through
+// lock-free queues, and the main thread alone touches the game state.
+// Arriving events are announced through an Allegro event source, so the
+// main thread can sleep in its event queue until there's work. The thread
+// sleeps as well until a packet arrives or a command is queued, which
+// sends a datagram to a local socket to wake it up.
+class NetworkThread {
+public:
+	static const unsigned int EVENT_TYPE = ALLEGRO_GET_EVENT_TYPE('O', 'G', 'B', 'N');
+
+	struct Event {
+		enum class Type {CONNECT, RECEIVE, DISCONNECT};
+
+		Type type;
+		Packet::Header header; // Of a received packet
+		ENetPacket *packet;    // Received packet, destroyed by the receiver
+	};
+
+	// Takes the ownership of the host, which is connecting to the peer
+	NetworkThread(ENetHost *host, ENetPeer *peer);
+	~NetworkThread(void);
+
+	// Join the thread and destroy the host, the later commands are dropped
+	void stop(void);
+
+	void send(const std::string &data, bool isReliable = true);
+	void send(const Packet &packet);
+	void disconnect(void);
+
+	// Get the next event from the network thread
+	bool receive(Event &event);
+
+	// Emits an event of EVENT_TYPE when events are waiting to be received
+	ALLEGRO_EVENT_SOURCE* getEventSource(void);
+
+	// Without a thread nothing happens unless the events are polled
+	bool needsPolling(void) const;
+
+	// In milliseconds
+	unsigned int getRoundTripTime(void) const;
+
+private:
+	struct Command {
+		enum class Type {SEND, DISCONNECT};
+
+		Type type;
+		ENetPacket *packet;
+	};
+
+	static const size_t QUEUE_CAPACITY = 4096;
+
+	// ENet retransmits and pings only while being serviced, so the idle
+	// thread wakes up this often
+	static const unsigned int SERVICE_TIMEOUT = 100;
+
+	// Without the wake-up socket the queued commands are sent this often
+	static const unsigned int POLL_TIMEOUT = 1;
+
+	ENetHost *host;
+	ENetPeer *peer;
+	ALLEGRO_THREAD *thread;
+
+	ENetSocket wakeSocket;
+	ENetAddress wakeAddress;
+	std::atomic<bool> wakePending; // A wake-up datagram hasn't been received yet
+
+	ALLEGRO_EVENT_SOURCE eventSource;
+	std::atomic<bool> signalled; // An announcement is waiting for the main thread
+
+	SpscQueue<Command> outgoing;
+	SpscQueue<Event> incoming;
+
+	// The overflow of a full queue is kept by the producer until it fits
+	std::deque<Command> pendingCommands;
+	std::deque<Event> pendingEvents;
+
+	std::atomic<unsigned int> roundTripTime;
+
+	void queueCommand(const Command &command);
+	void flushCommands(void);
+	bool postEvent(const Event &event);
+	void flushEvents(void);
+	void service(unsigned int timeout);
+
+	void openWakeSocket(void);
+	void wake(void);
+	void wait(unsigned int timeout);
+	void dropQueues(void);
+
+	static void* run(ALLEGRO_THREAD *thread, void *argument);
+};
+
+#endif
@@ -19,8 +19,9 @@
 
 #include "renderer.h"
 
-Renderer::Renderer(Coordinates screenSize, const int multisamplingSamples) {
+Renderer::Renderer(Coordinates screenSize, const int multisamplingSamples, const int loaderThreads, const bool cacheText) {
 	this->screenSize = screenSize;
+	this->cacheText = cacheText;
 
 	if (multisamplingSamples > 1) {
 		al_set_new_display_option(ALLEGRO_SAMPLE_BUFFERS, 1, ALLEGRO_SUGGEST);
@@ -54,15 +55,31 @@ Renderer::Renderer(Coordinates screenSize, const int multisamplingSamples) {
 	this->screenZoom = 2.0f;
 	this->screenLocation = Vector2(0.0f, 0.0f);
 	this->screenRotation = 0.0f;
+	this->transformation = Transformation::UI;
+	this->layer = nullptr;
 
 	al_set_new_bitmap_flags(ALLEGRO_MIN_LINEAR | ALLEGRO_MAG_LINEAR);
 
+	// A white pixel that is scaled and tinted to draw the textures that are still loading
+	this->placeholder = al_create_bitmap(1, 1);
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(this->placeholder);
+	al_clear_to_color(al_map_rgb_f(1.0f, 1.0f, 1.0f));
+	al_restore_state(&state);
+
+	this->textureLoader = new TextureLoader(loaderThreads);
+
 	this->resize();
 }
 
 Renderer::~Renderer() {
+	// Stop decoding before destroying the textures
+	delete this->textureLoader;
+
 	for (auto &texture : this->textures) {
-		if (texture.second != nullptr && this->textures["gfx/error"] != texture.second) {
+		// The textures in atlases are destroyed with the atlas
+		if (texture.second != nullptr && this->textures["gfx/error"] != texture.second && ! al_is_sub_bitmap(texture.second)) {
 			al_destroy_bitmap(texture.second);
 			texture.second = nullptr;
 		}
@@ -73,6 +90,28 @@ Renderer::~Renderer() {
 		this->textures["gfx/error"] = nullptr;
 	}
 
+	for (auto &levels : this->textureLevels) {
+		for (auto &level : levels) {
+			if (! al_is_sub_bitmap(level)) {
+				al_destroy_bitmap(level);
+			}
+		}
+	}
+
+	for (auto &atlas : this->atlases) {
+		delete atlas.second;
+	}
+
+	al_destroy_bitmap(this->placeholder);
+
+	if (this->layer != nullptr) {
+		al_destroy_bitmap(this->layer);
+	}
+
+	for (auto &text : this->textCache) {
+		al_destroy_bitmap(text.second.bitmap);
+	}
+
 	al_destroy_font(this->font);
 	al_destroy_display(this->display);
 }
@@ -123,6 +162,11 @@ void Renderer::updateTransformations() {
 	al_identity_transform(&this->cameraUI);
 }
 
+// Pixels per table unit
+float Renderer::getScreenScale() const {
+	return this->screenZoom / 2.0f;
+}
+
 void Renderer::zoomScreen(float factor) {
 	if (this->screenZoom * factor > 0.1f && this->screenZoom * factor < 30.0f)
 	this->screenZoom *= factor;
@@ -167,17 +211,244 @@ void Renderer::loadTexture(std::string texture) {
 	}
 }
 
-void Renderer::drawBitmap(std::string texture, Vector2 dest_location, Vector2 dest_size, float angle) {
-	this->loadTexture(texture);
-	Vector2 sizeFactor(dest_size.x / al_get_bitmap_width(this->textures[texture]), dest_size.y / al_get_bitmap_height(this->textures[texture]));
-	al_draw_scaled_rotated_bitmap(this->textures[texture], dest_size.x / (2.0f * sizeFactor.x), dest_size.y / (2.0f * sizeFactor.y),
-	                              dest_location.x, dest_location.y, sizeFactor.x, sizeFactor.y, angle, 0);
+// Put a decoded bitmap into the atlas of its package or into a bitmap of its own
+ALLEGRO_BITMAP* Renderer::uploadBitmap(std::string texture, ALLEGRO_BITMAP *bitmap) {
+	ALLEGRO_BITMAP *uploaded = nullptr;
+
+	const size_t objects = texture.find("/objects/");
+	if (objects != std::string::npos) {
+		uploaded = this->getAtlas(texture.substr(0, objects))->add(bitmap);
+	}
+
+	// Textures too large for the atlas are drawn on their own
+	if (uploaded == nullptr) {
+		uploaded = al_clone_bitmap(bitmap);
+	}
+
+	al_destroy_bitmap(bitmap);
+
+	return uploaded;
+}
+
+void Renderer::uploadTexture(const TextureLoader::Result &result) {
+	ALLEGRO_BITMAP *uploaded = nullptr;
+	std::vector<ALLEGRO_BITMAP*> levels;
+
+	if (result.bitmap == nullptr) {
+		std::cout << "Error: Texture " << result.path << " could not be loaded." << std::endl;
+		this->loadTexture("gfx/error");
+		uploaded = this->textures["gfx/error"];
+	} else {
+		uploaded = this->uploadBitmap(result.texture, result.bitmap);
+
+		// The levels end at the first one that couldn't be uploaded, the rest are only freed
+		bool failed = uploaded == nullptr;
+		for (auto &level : result.levels) {
+			if (failed) {
+				al_destroy_bitmap(level);
+				continue;
+			}
+
+			ALLEGRO_BITMAP *uploadedLevel = this->uploadBitmap(result.texture, level);
+			if (uploadedLevel == nullptr) {
+				failed = true;
+			} else {
+				levels.push_back(uploadedLevel);
+			}
+		}
+
+		if (uploaded == nullptr) {
+			std::cout << "Error: Texture " << result.path << " could not be uploaded." << std::endl;
+			this->loadTexture("gfx/error");
+			uploaded = this->textures["gfx/error"];
+		}
+	}
+
+	ALLEGRO_BITMAP *&loaded = this->textures[result.texture];
+	if (loaded != nullptr && loaded != this->textures["gfx/error"] && ! al_is_sub_bitmap(loaded)) {
+		al_destroy_bitmap(loaded);
+	}
+
+	loaded = uploaded;
+
+	auto handle = this->textureHandles.find(result.texture);
+	if (handle != this->textureHandles.end()) {
+		this->textureBitmaps.at(handle->second) = loaded;
+		this->textureLevels.at(handle->second).swap(levels);
+
+		if (result.bitmap != nullptr) {
+			this->textureColors.at(handle->second) = result.color;
+		}
+	}
+
+	// The replaced levels
+	for (auto &level : levels) {
+		if (level != nullptr && ! al_is_sub_bitmap(level)) {
+			al_destroy_bitmap(level);
+		}
+	}
+}
+
+TextureAtlas* Renderer::getAtlas(std::string package) {
+	auto atlas = this->atlases.find(package);
+	if (atlas != this->atlases.end()) {
+		return atlas->second;
+	}
+
+	int pageSize = MAX_ATLAS_SIZE;
+	const int maxBitmapSize = al_get_display_option(this->display, ALLEGRO_MAX_BITMAP_SIZE);
+	if (maxBitmapSize > 0) {
+		pageSize = std::min(pageSize, maxBitmapSize);
+	}
+
+	TextureAtlas *newAtlas = new TextureAtlas(pageSize);
+	this->atlases[package] = newAtlas;
+
+	return newAtlas;
+}
+
+// Upload the decoded textures until the time budget of the frame is used
+// Returns true if any textures were uploaded
+bool Renderer::uploadTextures(double timeBudget) {
+	const double startTime = al_get_time();
+	TextureLoader::Result result;
+	bool uploaded = false;
+
+	while (al_get_time() - startTime < timeBudget && this->textureLoader->getResult(result)) {
+		this->uploadTexture(result);
+		uploaded = true;
+	}
+
+	return uploaded;
+}
+
+bool Renderer::isLoadingTextures() const {
+	return this->textureLoader->isBusy();
 }
 
-void Renderer::drawBitmapTinted(std::string texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle) {
-	this->loadTexture(texture);
-	Vector2 sizeFactor(dest_size.x / al_get_bitmap_width(this->textures[texture]), dest_size.y / al_get_bitmap_height(this->textures[texture]));
-	al_draw_tinted_scaled_rotated_bitmap(this->textures[texture], al_map_rgba_f(color.red, color.green, color.blue, color.alpha),
+void Renderer::beginLayer() {
+	// The layer follows the size of the display
+	if (this->layer != nullptr && (al_get_bitmap_width(this->layer) != al_get_display_width(this->display)
+	                               || al_get_bitmap_height(this->layer) != al_get_display_height(this->display))) {
+		al_destroy_bitmap(this->layer);
+		this->layer = nullptr;
+	}
+
+	if (this->layer == nullptr) {
+		this->layer = al_create_bitmap(al_get_display_width(this->display), al_get_display_height(this->display));
+	}
+
+	al_set_target_bitmap(this->layer);
+}
+
+void Renderer::endLayer() {
+	al_set_target_backbuffer(this->display);
+}
+
+void Renderer::drawLayer() {
+	if (this->layer == nullptr) {
+		return;
+	}
+
+	ALLEGRO_TRANSFORM identity;
+	al_identity_transform(&identity);
+	al_use_transform(&identity);
+
+	al_draw_bitmap(this->layer, 0.0f, 0.0f, 0);
+
+	this->useTransformation(this->transformation);
+}
+
+unsigned int Renderer::getTexture(std::string texture) {
+	auto handle = this->textureHandles.find(texture);
+
+	if (handle == this->textureHandles.end()) {
+		const unsigned int newHandle = this->textureNames.size();
+		this->textureHandles[texture] = newHandle;
+		this->textureNames.push_back(texture);
+		this->textureBitmaps.push_back(nullptr);
+		this->textureSizes.push_back(Coordinates(0, 0));
+		this->textureLevels.push_back(std::vector<ALLEGRO_BITMAP*>());
+		this->textureColors.push_back(Color(PLACEHOLDER_SHADE, PLACEHOLDER_SHADE, PLACEHOLDER_SHADE));
+		this->textureRequested.push_back(false);
+
+		return newHandle;
+	}
+
+	// Try to load a missing texture again, its package may have been downloaded
+	if (this->textureBitmaps.at(handle->second) == this->textures["gfx/error"] && texture != "gfx/error") {
+		this->textureBitmaps.at(handle->second) = nullptr;
+		this->textureRequested.at(handle->second) = false;
+	}
+
+	return handle->second;
+}
+
+// Start decoding the texture in the background and read its size from the image header
+void Renderer::requestTexture(unsigned int texture) {
+	const std::string &name = this->textureNames[texture];
+	this->textureRequested[texture] = true;
+
+	auto loaded = this->textures.find(name);
+	if (loaded != this->textures.end() && loaded->second != nullptr && loaded->second != this->textures["gfx/error"]) {
+		this->textureBitmaps[texture] = loaded->second;
+		return;
+	}
+
+	std::string path;
+	if (PHYSFS_exists((name + ".png").c_str())) {
+		path = name + ".png";
+	} else if (PHYSFS_exists((name + ".jpg").c_str())) {
+		path = name + ".jpg";
+	} else {
+		std::cout << "Error: Texture " << name << ".{png|jpg}" << " could not be loaded." << std::endl;
+		this->loadTexture("gfx/error");
+		this->textureBitmaps[texture] = this->textures["gfx/error"];
+		return;
+	}
+
+	utils::readImageSize(path, this->textureSizes[texture]);
+	this->textureLoader->load(name, path);
+}
+
+// Only the first use of a handle goes through the texture names. Returns
+// nullptr while the texture is being loaded.
+ALLEGRO_BITMAP* Renderer::getBitmap(unsigned int texture) {
+	if (this->textureBitmaps[texture] == nullptr && ! this->textureRequested[texture]) {
+		this->requestTexture(texture);
+	}
+
+	return this->textureBitmaps[texture];
+}
+
+void Renderer::drawBitmap(unsigned int texture, Vector2 dest_location, Vector2 dest_size, float angle) {
+	this->drawBitmapTinted(texture, dest_location, dest_size, Color(1.0f, 1.0f, 1.0f, 1.0f), angle);
+}
+
+void Renderer::drawBitmapTinted(unsigned int texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle) {
+	ALLEGRO_BITMAP *bitmap = this->getBitmap(texture);
+
+	// Draw a grey box of the same size until the texture has been loaded
+	if (bitmap == nullptr) {
+		bitmap = this->placeholder;
+		color.red *= PLACEHOLDER_SHADE;
+		color.green *= PLACEHOLDER_SHADE;
+		color.blue *= PLACEHOLDER_SHADE;
+	} else if (this->transformation == Transformation::CAMERA) {
+		// Use the smallest level of detail that is still at least as wide as the texture on the screen
+		const float screenWidth = dest_size.x * this->getScreenScale();
+
+		for (auto &level : this->textureLevels[texture]) {
+			if (al_get_bitmap_width(level) < screenWidth) {
+				break;
+			}
+
+			bitmap = level;
+		}
+	}
+
+	Vector2 sizeFactor(dest_size.x / al_get_bitmap_width(bitmap), dest_size.y / al_get_bitmap_height(bitmap));
+	al_draw_tinted_scaled_rotated_bitmap(bitmap, al_map_rgba_f(color.red, color.green, color.blue, color.alpha),
 	                                     dest_size.x / (2.0f * sizeFactor.x), dest_size.y / (2.0f * sizeFactor.y), dest_location.x, dest_location.y,
 	                                     sizeFactor.x, sizeFactor.y, angle, 0);
 
@@ -232,6 +503,71 @@ void Renderer::drawCircleFilled(Vector2 location, float radius, Color color, Tra
 	al_hold_bitmap_drawing(true);
 }
 
+void Renderer::addOverlayRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation) {
+	Vector2 pointAB = Vector2(pointA.x, pointB.y);
+	Vector2 pointBA = Vector2(pointB.x, pointA.y);
+	float thicknessFactor = this->getThicknessFactor(transformation);
+	ALLEGRO_COLOR allegroColor = al_map_rgba_f(color.red, color.green, color.blue, color.alpha);
+
+	this->addOverlayLine(pointA, pointAB, allegroColor, thicknessFactor * thickness);
+	this->addOverlayLine(pointA, pointBA, allegroColor, thicknessFactor * thickness);
+	this->addOverlayLine(pointB, pointAB, allegroColor, thicknessFactor * thickness);
+	this->addOverlayLine(pointB, pointBA, allegroColor, thicknessFactor * thickness);
+}
+
+void Renderer::addOverlayRectangleFilled(Vector2 pointA, Vector2 pointB, Color color) {
+	this->addOverlayQuad(pointA, Vector2(pointB.x, pointA.y), pointB, Vector2(pointA.x, pointB.y),
+	                     al_map_rgba_f(color.red, color.green, color.blue, color.alpha));
+}
+
+// Draw all overlay primitives with a single call using the current transformation
+void Renderer::drawOverlay() {
+	if (this->overlay.empty()) {
+		return;
+	}
+
+	al_hold_bitmap_drawing(false);
+	al_draw_prim(&this->overlay.front(), nullptr, nullptr, 0, this->overlay.size(), ALLEGRO_PRIM_TRIANGLE_LIST);
+	al_hold_bitmap_drawing(true);
+
+	this->overlay.clear();
+}
+
+void Renderer::addOverlayVertex(Vector2 location, ALLEGRO_COLOR color) {
+	ALLEGRO_VERTEX vertex;
+	vertex.x = location.x;
+	vertex.y = location.y;
+	vertex.z = 0.0f;
+	vertex.u = 0.0f;
+	vertex.v = 0.0f;
+	vertex.color = color;
+
+	this->overlay.push_back(vertex);
+}
+
+// The corners are given in order around the quad
+void Renderer::addOverlayQuad(Vector2 pointA, Vector2 pointB, Vector2 pointC, Vector2 pointD, ALLEGRO_COLOR color) {
+	this->addOverlayVertex(pointA, color);
+	this->addOverlayVertex(pointB, color);
+	this->addOverlayVertex(pointC, color);
+
+	this->addOverlayVertex(pointA, color);
+	this->addOverlayVertex(pointC, color);
+	this->addOverlayVertex(pointD, color);
+}
+
+// A thick line is a quad like in al_draw_line
+void Renderer::addOverlayLine(Vector2 pointA, Vector2 pointB, ALLEGRO_COLOR color, float thickness) {
+	const Vector2 direction = pointB - pointA;
+	if (direction.len2() == 0.0f) {
+		return;
+	}
+
+	const Vector2 normal = Vector2(-direction.y, direction.x).nor() * (thickness / 2.0f);
+
+	this->addOverlayQuad(pointA + normal, pointB + normal, pointB - normal, pointA - normal, color);
+}
+
 float Renderer::getThicknessFactor(Transformation transformation) {
 	if (transformation == Transformation::CAMERA) {
 		return 2.0f / this->screenZoom;
@@ -241,6 +577,96 @@ float Renderer::getThicknessFactor(Transformation transformation) {
 }
 
 void Renderer::drawText(std::string text, Vector2 location, Alignment alignment) {
+	const CachedText *cached = this->cacheText ? this->getCachedText(text) : nullptr;
+
+	if (cached == nullptr) {
+		this->drawTextRuns(text, location, alignment);
+		return;
+	}
+
+	if (alignment == Alignment::CENTER) {
+		location.x -= cached->width / 2.0f;
+	} else if (alignment == Alignment::RIGHT) {
+		location.x -= cached->width;
+	}
+
+	al_draw_bitmap(cached->bitmap, location.x, location.y, 0);
+}
+
+// Get the bitmap of a text, rendering it when it is drawn for the second time
+const Renderer::CachedText* Renderer::getCachedText(const std::string &text) {
+	std::map<std::string, CachedText>::iterator cached = this->textCache.find(text);
+
+	if (cached != this->textCache.end()) {
+		this->textCacheUses.splice(this->textCacheUses.begin(), this->textCacheUses, cached->second.use);
+		return &cached->second;
+	}
+
+	// Texts that change every frame would only churn the cache
+	std::map<std::string, std::list<std::string>::iterator>::iterator seen = this->seenTexts.find(text);
+	if (seen == this->seenTexts.end()) {
+		if (this->seenTexts.size() >= TEXT_CACHE_SIZE) {
+			this->seenTexts.erase(this->seenTextUses.back());
+			this->seenTextUses.pop_back();
+		}
+
+		this->seenTextUses.push_front(text);
+		this->seenTexts[text] = this->seenTextUses.begin();
+		return nullptr;
+	}
+
+	this->seenTextUses.erase(seen->second);
+	this->seenTexts.erase(seen);
+
+	// The colour codes make the text narrower than this when drawn
+	const int width = al_get_text_width(this->font, text.c_str());
+	const int height = al_get_font_line_height(this->font);
+
+	if (width <= 0 || height <= 0) {
+		return nullptr;
+	}
+
+	ALLEGRO_BITMAP *bitmap = al_create_bitmap(width, height);
+	if (bitmap == nullptr) {
+		return nullptr;
+	}
+
+	if (this->textCache.size() >= TEXT_CACHE_SIZE) {
+		std::map<std::string, CachedText>::iterator oldest = this->textCache.find(this->textCacheUses.back());
+
+		al_destroy_bitmap(oldest->second.bitmap);
+		this->textCache.erase(oldest);
+		this->textCacheUses.pop_back();
+	}
+
+	// The held bitmaps have to be drawn before changing the target
+	const bool held = al_is_bitmap_drawing_held();
+	if (held) {
+		al_hold_bitmap_drawing(false);
+	}
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_TRANSFORM);
+	al_set_target_bitmap(bitmap);
+	al_clear_to_color(al_map_rgba_f(0.0f, 0.0f, 0.0f, 0.0f));
+
+	CachedText &entry = this->textCache[text];
+	entry.bitmap = bitmap;
+	entry.width = this->drawTextRuns(text, Vector2(0.0f, 0.0f), Alignment::LEFT);
+	this->textCacheUses.push_front(text);
+	entry.use = this->textCacheUses.begin();
+
+	al_restore_state(&state);
+
+	if (held) {
+		al_hold_bitmap_drawing(true);
+	}
+
+	return &entry;
+}
+
+// Draw the text in runs of the colours set by the colour codes, returns the drawn width
+float Renderer::drawTextRuns(const std::string &text, Vector2 location, Alignment alignment) {
 	size_t position = 0;
 	size_t oldposition = 0;
 	float drawposition = 0.0f;
@@ -275,12 +701,28 @@ void Renderer::drawText(std::string text, Vector2 location, Alignment alignment)
 			oldposition = text.length() -1;
 		}
 	} while (loop);
+
+	return drawposition;
 }
 
-Coordinates Renderer::getTextureSize(std::string texture) {
-	this->loadTexture(texture);
+// The size of a texture that is still loading comes from its image header
+Coordinates Renderer::getTextureSize(unsigned int texture) {
+	ALLEGRO_BITMAP *bitmap = this->getBitmap(texture);
 
-	return Coordinates(al_get_bitmap_width(this->textures[texture]), al_get_bitmap_height(this->textures[texture]));
+	if (bitmap == nullptr) {
+		if (this->textureSizes[texture] != Coordinates(0, 0)) {
+			return this->textureSizes[texture];
+		}
+
+		this->loadTexture("gfx/error");
+		bitmap = this->textures["gfx/error"];
+	}
+
+	return Coordinates(al_get_bitmap_width(bitmap), al_get_bitmap_height(bitmap));
+}
+
+Color Renderer::getTextureColor(unsigned int texture) const {
+	return this->textureColors.at(texture);
 }
 
 ALLEGRO_TRANSFORM* Renderer::getTransformation(Transformation transformation) {
@@ -335,7 +777,26 @@ void Renderer::transformLocation(Transformation transformation, Vector2 &locatio
 	al_transform_coordinates(this->getTransformation(transformation), &location.x, &location.y);
 }
 
+// The axis aligned box of the table that contains the whole rotated screen
+void Renderer::getViewBounds(Vector2 &min, Vector2 &max) {
+	Vector2 corners[4] = {Vector2(0.0f, 0.0f), Vector2(this->screenSize.x, 0.0f),
+	                      Vector2(0.0f, this->screenSize.y), Vector2(this->screenSize.x, this->screenSize.y)};
+
+	for (int i = 0; i < 4; ++i) {
+		this->transformLocation(CAMERA_INVERSE, corners[i]);
+
+		if (i == 0) {
+			min = corners[i];
+			max = corners[i];
+		} else {
+			min = Vector2(std::min(min.x, corners[i].x), std::min(min.y, corners[i].y));
+			max = Vector2(std::max(max.x, corners[i].x), std::max(max.y, corners[i].y));
+		}
+	}
+}
+
 void Renderer::useTransformation(Transformation transformation) {
+	this->transformation = transformation;
 	al_use_transform(this->getTransformation(transformation));
 }
 
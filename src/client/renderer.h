@@ -21,7 +21,11 @@
 #define RENDERER_H
 
 #include <map>
+#include <list>
+#include <vector>
 #include <string>
+#include <utility>
+#include <algorithm>
 #include <iostream>
 #include <stdio.h>
 
@@ -31,15 +35,27 @@
 #include <allegro5/allegro_ttf.h>
 #include <allegro5/allegro_primitives.h>
 #include <allegro5/allegro_color.h>
+#include <physfs.h>
 
 #include "../irenderer.h"
 #include "../utils.h"
 #include "../vector2.h"
 #include "../color.h"
+#include "textureAtlas.h"
+#include "textureLoader.h"
+
+// The largest atlas page, the graphics driver may limit it further
+const int MAX_ATLAS_SIZE = 2048;
+
+// How much darker the placeholders of the loading textures are
+const float PLACEHOLDER_SHADE = 0.3f;
+
+// The number of rendered texts kept for drawing them again
+const size_t TEXT_CACHE_SIZE = 256;
 
 class Renderer : public IRenderer {
 public:
-	Renderer(Coordinates screenSize, const int multisamplingSamples);
+	Renderer(Coordinates screenSize, const int multisamplingSamples, const int loaderThreads, const bool cacheText);
 	virtual ~Renderer(void);
 
 	ALLEGRO_DISPLAY* getDisplay(void) const;
@@ -50,13 +66,24 @@ public:
 	virtual void setWindowTitle(std::string title, std::string icon);
 	virtual void updateTransformations(void);
 
+	virtual float getScreenScale(void) const;
 	virtual void zoomScreen(float zoom);
 	virtual void scrollScreen(Vector2 translation);
 	virtual void rotateScreen(float angle);
 	virtual void setScreenSize(Coordinates screenSize);
 
-	virtual void drawBitmap(std::string texture, Vector2 dest_location, Vector2 dest_size, float angle = 0);
-	virtual void drawBitmapTinted(std::string texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle = 0);
+	virtual unsigned int getTexture(std::string texture);
+	bool uploadTextures(double timeBudget);
+	bool isLoadingTextures(void) const;
+
+	// Draws into an off-screen layer of the size of the display, which can
+	// be drawn again without drawing its contents
+	void beginLayer(void);
+	void endLayer(void);
+	void drawLayer(void);
+
+	virtual void drawBitmap(unsigned int texture, Vector2 dest_location, Vector2 dest_size, float angle = 0);
+	virtual void drawBitmapTinted(unsigned int texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle = 0);
 
 	virtual void drawLine(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI);
 
@@ -68,9 +95,17 @@ public:
 
 	virtual void drawText(std::string text, Vector2 location, Alignment alignment = Alignment::LEFT);
 
-	virtual Coordinates getTextureSize(std::string texture);
+	virtual void addOverlayRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI);
+	virtual void addOverlayRectangleFilled(Vector2 pointA, Vector2 pointB, Color color);
+	virtual void drawOverlay(void);
+
+	// The average colour of a texture, for drawing it as a single quad
+	Color getTextureColor(unsigned int texture) const;
+
+	virtual Coordinates getTextureSize(unsigned int texture);
 
 	virtual void transformLocation(Transformation transformation, Vector2 &location);
+	virtual void getViewBounds(Vector2 &min, Vector2 &max);
 	virtual void useTransformation(Transformation transformation);
 
 	virtual void hsvToRgb(float hue, float saturation, float value, Color *color);
@@ -87,15 +122,60 @@ private:
 	float screenZoom;
 	Vector2 screenLocation;
 	float screenRotation;
+	Transformation transformation;
 
 	std::map<std::string, ALLEGRO_BITMAP*> textures;
+	std::map<std::string, TextureAtlas*> atlases;
+
+	// The textures by handle, nullptr until the texture has been loaded
+	std::map<std::string, unsigned int> textureHandles;
+	std::vector<std::string> textureNames;
+	std::vector<ALLEGRO_BITMAP*> textureBitmaps;
+	std::vector<Coordinates> textureSizes;
+	std::vector<bool> textureRequested;
+	std::vector<std::vector<ALLEGRO_BITMAP*>> textureLevels; // Halved levels of detail
+	std::vector<Color> textureColors; // Averages of the textures
+
+	TextureLoader *textureLoader;
+	ALLEGRO_BITMAP *placeholder;
+	ALLEGRO_BITMAP *layer;
+
+	// Triangles of the overlay primitives
+	std::vector<ALLEGRO_VERTEX> overlay;
+
+	// The texts drawn a second time are rendered into bitmaps by their
+	// contents, including the colour codes, and the least recently drawn
+	// ones are dropped. Both lists start with the most recent text.
+	struct CachedText {
+		ALLEGRO_BITMAP *bitmap;
+		float width;
+		std::list<std::string>::iterator use;
+	};
+
+	bool cacheText;
+	std::map<std::string, CachedText> textCache;
+	std::list<std::string> textCacheUses;
+	std::map<std::string, std::list<std::string>::iterator> seenTexts;
+	std::list<std::string> seenTextUses;
 
 	void loadTexture(std::string);
+	void requestTexture(unsigned int texture);
+	ALLEGRO_BITMAP* uploadBitmap(std::string texture, ALLEGRO_BITMAP *bitmap);
+	void uploadTexture(const TextureLoader::Result &result);
+	TextureAtlas* getAtlas(std::string package);
+	ALLEGRO_BITMAP* getBitmap(unsigned int texture);
 
 	ALLEGRO_TRANSFORM* getTransformation(Transformation transformation);
 	int getAlignment(IRenderer::Alignment alignment);
 
+	float drawTextRuns(const std::string &text, Vector2 location, Alignment alignment);
+	const CachedText* getCachedText(const std::string &text);
+
 	float getThicknessFactor(Transformation transformation);
+
+	void addOverlayVertex(Vector2 location, ALLEGRO_COLOR color);
+	void addOverlayQuad(Vector2 pointA, Vector2 pointB, Vector2 pointC, Vector2 pointD, ALLEGRO_COLOR color);
+	void addOverlayLine(Vector2 pointA, Vector2 pointB, ALLEGRO_COLOR color, float thickness);
 };
 
 #endif
@@ -0,0 +1,186 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "serverBrowser.h"
+
+ServerBrowser::ServerBrowser(unsigned int concurrency, double timeout)
+: concurrency(concurrency),
+  timeout(timeout),
+  probeCount(0) {
+	this->connection = enet_host_create(nullptr, concurrency, 1, 0, 0);
+}
+
+ServerBrowser::~ServerBrowser() {
+	if (this->connection != nullptr) {
+		enet_host_destroy(this->connection);
+	}
+}
+
+// The information from the server list is kept if the server doesn't respond
+void ServerBrowser::addServer(std::string address, unsigned short port, std::string name, unsigned short players, unsigned short slots) {
+	Result result;
+	result.address = address;
+	result.port = port;
+	result.responded = false;
+	result.latency = 0.0;
+	result.name = name;
+	result.players = players;
+	result.slots = slots;
+
+	this->queue.push_back(result);
+	++this->probeCount;
+}
+
+void ServerBrowser::update() {
+	if (this->connection == nullptr) {
+		// Every probe fails without a connection
+		while (! this->queue.empty()) {
+			this->results.push_back(this->queue.front());
+			this->queue.pop_front();
+		}
+
+		return;
+	}
+
+	this->startProbes();
+
+	ENetEvent event;
+
+	while (enet_host_service(this->connection, &event, 0) > 0) {
+		switch (event.type) {
+			case ENET_EVENT_TYPE_CONNECT: {
+				// Game servers answer a server list query with their own information
+				Packet packet(event.peer);
+				packet.writeHeader(Packet::Header::MS_QUERY);
+				packet.send();
+
+				this->probes[event.peer].queryTime = utils::getTime();
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_RECEIVE: {
+				if (this->probes.count(event.peer) != 0) {
+					Probe &probe = this->probes[event.peer];
+					probe.result.latency = utils::getTime() - probe.queryTime;
+
+					try {
+						Packet packet(event.packet);
+
+						if (packet.readHeader() == Packet::Header::MS_QUERY) {
+							packet.readShort(); // Number of servers
+							packet.readShort(); // Next page
+							packet.readString(); // The server doesn't know its public address
+							packet.readShort();
+							probe.result.name = packet.readString();
+							probe.result.players = packet.readShort();
+							probe.result.slots = packet.readShort();
+						}
+
+						this->finishProbe(event.peer, true);
+					} catch (PacketException &e) {
+						this->finishProbe(event.peer, false);
+					}
+				}
+
+				enet_packet_destroy(event.packet);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_DISCONNECT: {
+				if (this->probes.count(event.peer) != 0) {
+					this->finishProbe(event.peer, false);
+				}
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_NONE: {
+				break;
+			}
+		}
+	}
+
+	// Give up on the servers that are too slow to answer
+	const double time = utils::getTime();
+
+	for (auto probe = this->probes.begin(); probe != this->probes.end();) {
+		ENetPeer *peer = probe->first;
+		const bool expired = probe->second.startTime + this->timeout < time;
+		++probe;
+
+		if (expired) {
+			this->finishProbe(peer, false);
+		}
+	}
+}
+
+// Get the next finished probe
+bool ServerBrowser::getResult(Result &result) {
+	if (this->results.empty()) {
+		return false;
+	}
+
+	result = this->results.front();
+	this->results.pop_front();
+
+	return true;
+}
+
+bool ServerBrowser::isDone() const {
+	return this->queue.empty() && this->probes.empty() && this->results.empty();
+}
+
+size_t ServerBrowser::getProbeCount() const {
+	return this->probeCount;
+}
+
+void ServerBrowser::startProbes() {
+	while (! this->queue.empty() && this->probes.size() < this->concurrency) {
+		Result result = this->queue.front();
+		this->queue.pop_front();
+
+		ENetAddress address;
+		ENetPeer *peer = nullptr;
+
+		if (enet_address_set_host(&address, result.address.c_str()) == 0) {
+			address.port = result.port;
+			peer = enet_host_connect(this->connection, &address, 1, 0);
+		}
+
+		if (peer == nullptr) {
+			this->results.push_back(result);
+			continue;
+		}
+
+		Probe &probe = this->probes[peer];
+		probe.result = result;
+		probe.startTime = utils::getTime();
+		probe.queryTime = probe.startTime;
+	}
+}
+
+void ServerBrowser::finishProbe(ENetPeer *peer, bool responded) {
+	Probe &probe = this->probes[peer];
+	probe.result.responded = responded;
+	this->results.push_back(probe.result);
+
+	// Free the peer for the next probe right away
+	enet_peer_disconnect_now(peer, 0);
+	this->probes.erase(peer);
+}
@@ -0,0 +1,75 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SERVERBROWSER_H
+#define SERVERBROWSER_H
+
+#include <map>
+#include <deque>
+#include <string>
+
+#include <enet/enet.h>
+
+#include "../net.h"
+#include "../packet.h"
+#include "../utils.h"
+
+// Probes the latency and the player count of game servers. The probes share
+// one ENet host and a limited number of them run at the same time.
+class ServerBrowser {
+public:
+	struct Result {
+		std::string address;
+		unsigned short port;
+		bool responded;
+		double latency;         // Seconds from the query to the reply
+		std::string name;
+		unsigned short players;
+		unsigned short slots;
+	};
+
+	ServerBrowser(unsigned int concurrency, double timeout);
+	~ServerBrowser(void);
+
+	void addServer(std::string address, unsigned short port, std::string name, unsigned short players, unsigned short slots);
+	void update(void);
+
+	bool getResult(Result &result);
+	bool isDone(void) const;
+	size_t getProbeCount(void) const;
+
+private:
+	ENetHost *connection;
+	unsigned int concurrency;
+	double timeout;
+
+	struct Probe {
+		Result result;
+		double startTime;
+		double queryTime;
+	};
+
+	std::deque<Result> queue;
+	std::map<ENetPeer*, Probe> probes;
+	std::deque<Result> results;
+	size_t probeCount;
+
+	void startProbes(void);
+	void finishProbe(ENetPeer *peer, bool responded);
+};
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "spatialIndex.h"
+
+SpatialIndex::SpatialIndex(float cellSize)
+: cellSize(cellSize),
+  nextDepth(0) {
+
+}
+
+// Add the object on top of the others or move it to the cells of its current bounds
+void SpatialIndex::update(Object *object) {
+	Vector2 min;
+	Vector2 max;
+	object->getBounds(min, max);
+
+	Entry entry;
+	entry.minX = this->getCell(min.x);
+	entry.minY = this->getCell(min.y);
+	entry.maxX = this->getCell(max.x);
+	entry.maxY = this->getCell(max.y);
+
+	auto oldEntry = this->entries.find(object);
+
+	if (oldEntry == this->entries.end()) {
+		entry.depth = this->nextDepth++;
+	} else {
+		if (oldEntry->second.minX == entry.minX && oldEntry->second.minY == entry.minY
+		    && oldEntry->second.maxX == entry.maxX && oldEntry->second.maxY == entry.maxY) {
+			return;
+		}
+
+		entry.depth = oldEntry->second.depth;
+		this->removeFromCells(object, oldEntry->second);
+	}
+
+	this->addToCells(object, entry);
+	this->entries[object] = entry;
+}
+
+// Move the object on top of the others
+void SpatialIndex::raise(Object *object) {
+	auto entry = this->entries.find(object);
+
+	if (entry != this->entries.end()) {
+		entry->second.depth = this->nextDepth++;
+	}
+}
+
+void SpatialIndex::remove(Object *object) {
+	auto entry = this->entries.find(object);
+
+	if (entry != this->entries.end()) {
+		this->removeFromCells(object, entry->second);
+		this->entries.erase(entry);
+	}
+}
+
+void SpatialIndex::clear() {
+	this->entries.clear();
+	this->cells.clear();
+	this->nextDepth = 0;
+}
+
+// Find the objects whose cells overlap the area, in the drawing order
+void SpatialIndex::query(Vector2 min, Vector2 max, std::vector<Object*> &objects) const {
+	const int minX = this->getCell(min.x);
+	const int minY = this->getCell(min.y);
+	const int maxX = this->getCell(max.x);
+	const int maxY = this->getCell(max.y);
+
+	std::vector<std::pair<unsigned int, Object*>> found;
+
+	auto addCell = [&](const std::vector<Object*> &cell) {
+		for (auto &object : cell) {
+			found.push_back(std::make_pair(this->entries.at(object).depth, object));
+		}
+	};
+
+	// A large area is faster to check against the occupied cells
+	if (static_cast<size_t>(maxX - minX + 1) * static_cast<size_t>(maxY - minY + 1) > this->cells.size()) {
+		for (auto &cell : this->cells) {
+			const int x = static_cast<int>(cell.first >> 32);
+			const int y = static_cast<int>(cell.first & 0xFFFFFFFF);
+
+			if (x >= minX && x <= maxX && y >= minY && y <= maxY) {
+				addCell(cell.second);
+			}
+		}
+	} else {
+		for (int x = minX; x <= maxX; ++x) {
+			for (int y = minY; y <= maxY; ++y) {
+				auto cell = this->cells.find(this->getKey(x, y));
+
+				if (cell != this->cells.end()) {
+					addCell(cell->second);
+				}
+			}
+		}
+	}
+
+	// Objects in several cells are found more than once
+	std::sort(found.begin(), found.end());
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+
+	objects.clear();
+	objects.reserve(found.size());
+
+	for (auto &object : found) {
+		objects.push_back(object.second);
+	}
+}
+
+long long SpatialIndex::getKey(int x, int y) const {
+	// Shift the bits unsigned, the coordinates may be negative
+	return static_cast<long long>((static_cast<unsigned long long>(static_cast<unsigned int>(x)) << 32)
+	                              | static_cast<unsigned int>(y));
+}
+
+// The objects can't be outside the table, which also limits the number of cells
+int SpatialIndex::getCell(float coordinate) const {
+	coordinate = std::max(-net::MAX_FLOAT, std::min(net::MAX_FLOAT, coordinate));
+
+	return static_cast<int>(std::floor(coordinate / this->cellSize));
+}
+
+void SpatialIndex::addToCells(Object *object, const Entry &entry) {
+	for (int x = entry.minX; x <= entry.maxX; ++x) {
+		for (int y = entry.minY; y <= entry.maxY; ++y) {
+			this->cells[this->getKey(x, y)].push_back(object);
+		}
+	}
+}
+
+void SpatialIndex::removeFromCells(Object *object, const Entry &entry) {
+	for (int x = entry.minX; x <= entry.maxX; ++x) {
+		for (int y = entry.minY; y <= entry.maxY; ++y) {
+			auto cell = this->cells.find(this->getKey(x, y));
+
+			if (cell != this->cells.end()) {
+				cell->second.erase(std::remove(cell->second.begin(), cell->second.end(), object), cell->second.end());
+
+				if (cell->second.empty()) {
+					this->cells.erase(cell);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+#include "../vector2.h"
+#include "../object.h"
+#include "../net.h"
+
+// A uniform grid of the objects on the table for finding the objects in an
+// area without going through all of them. The index also keeps the drawing
+// order so that the found objects can be returned from the bottom up.
+class SpatialIndex {
+public:
+	SpatialIndex(float cellSize);
+
+	void update(Object *object);
+	void raise(Object *object);
+	void remove(Object *object);
+	void clear(void);
+
+	void query(Vector2 min, Vector2 max, std::vector<Object*> &objects) const;
+
+private:
+	struct Entry {
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+		unsigned int depth;
+	};
+
+	float cellSize;
+	unsigned int nextDepth;
+
+	std::unordered_map<Object*, Entry> entries;
+	std::unordered_map<long long, std::vector<Object*>> cells;
+
+	long long getKey(int x, int y) const;
+	int getCell(float coordinate) const;
+
+	void addToCells(Object *object, const Entry &entry);
+	void removeFromCells(Object *object, const Entry &entry);
+};
+
+#endif
@@ -0,0 +1,102 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+// A bounded lock-free queue between exactly one producer thread and one
+// consumer thread. The producer only writes the tail and the consumer only
+// writes the head, so neither of them ever waits for the other.
+template <class T>
+class SpscQueue {
+public:
+	// The capacity is rounded up to a power of two
+	SpscQueue(size_t capacity);
+
+	// Called only from the producer thread, false if the queue is full
+	bool push(const T &value);
+
+	// Called only from the consumer thread, false if the queue is empty
+	bool pop(T &value);
+
+	bool isEmpty(void) const;
+
+private:
+	// Keep the indices on their own cache lines, so that the threads don't
+	// invalidate each other's lines on every operation.
+	static const size_t CACHE_LINE = 64;
+
+	std::vector<T> buffer;
+	size_t mask;
+
+	char headPadding[CACHE_LINE];
+	std::atomic<size_t> head; // Next slot to pop
+	char tailPadding[CACHE_LINE];
+	std::atomic<size_t> tail; // Next slot to push
+};
+
+template <class T>
+SpscQueue<T>::SpscQueue(size_t capacity)
+: head(0),
+  tail(0) {
+	size_t size = 1;
+	while (size < capacity) {
+		size *= 2;
+	}
+
+	this->buffer.resize(size);
+	this->mask = size - 1;
+}
+
+template <class T>
+bool SpscQueue<T>::push(const T &value) {
+	const size_t tail = this->tail.load(std::memory_order_relaxed);
+
+	if (tail - this->head.load(std::memory_order_acquire) == this->buffer.size()) {
+		return false;
+	}
+
+	this->buffer[tail & this->mask] = value;
+	this->tail.store(tail + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <class T>
+bool SpscQueue<T>::pop(T &value) {
+	const size_t head = this->head.load(std::memory_order_relaxed);
+
+	if (head == this->tail.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	value = this->buffer[head & this->mask];
+	this->head.store(head + 1, std::memory_order_release);
+
+	return true;
+}
+
+template <class T>
+bool SpscQueue<T>::isEmpty() const {
+	return this->head.load(std::memory_order_acquire) == this->tail.load(std::memory_order_acquire);
+}
+
+#endif
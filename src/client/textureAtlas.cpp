@@ -0,0 +1,156 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "textureAtlas.h"
+
+// Empty pixels around every texture keep the linear filtering from
+// blending in the neighbouring textures.
+const int GUTTER = 1;
+
+TextureAtlas::TextureAtlas(int pageSize)
+: pageSize(pageSize) {
+
+}
+
+TextureAtlas::~TextureAtlas() {
+	// The regions have to be destroyed before their pages
+	for (auto &region : this->regions) {
+		al_destroy_bitmap(region);
+	}
+
+	for (auto &page : this->pages) {
+		al_destroy_bitmap(page.bitmap);
+	}
+}
+
+// Copy the bitmap into the atlas and return the region of the atlas that
+// can be used in place of it. Returns nullptr if the bitmap doesn't fit.
+ALLEGRO_BITMAP* TextureAtlas::add(ALLEGRO_BITMAP *bitmap) {
+	const int width = al_get_bitmap_width(bitmap);
+	const int height = al_get_bitmap_height(bitmap);
+
+	if (width + 2 * GUTTER > this->pageSize || height + 2 * GUTTER > this->pageSize) {
+		return nullptr;
+	}
+
+	int x = 0;
+	int y = 0;
+	Page *page = nullptr;
+
+	for (auto &candidate : this->pages) {
+		if (this->allocate(candidate, width, height, x, y)) {
+			page = &candidate;
+			break;
+		}
+	}
+
+	if (page == nullptr) {
+		if (! this->addPage() || ! this->allocate(this->pages.back(), width, height, x, y)) {
+			return nullptr;
+		}
+
+		page = &this->pages.back();
+	}
+
+	// Draw the texture without blending so that the alpha channel is copied as is
+	const bool held = al_is_bitmap_drawing_held();
+	al_hold_bitmap_drawing(false);
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP | ALLEGRO_STATE_BLENDER);
+	al_set_target_bitmap(page->bitmap);
+	al_set_blender(ALLEGRO_ADD, ALLEGRO_ONE, ALLEGRO_ZERO);
+
+	al_draw_bitmap(bitmap, x, y, 0);
+
+	// Repeat the edges in the gutter
+	al_draw_bitmap_region(bitmap, 0, 0, width, 1, x, y - 1, 0);
+	al_draw_bitmap_region(bitmap, 0, height - 1, width, 1, x, y + height, 0);
+	al_draw_bitmap_region(bitmap, 0, 0, 1, height, x - 1, y, 0);
+	al_draw_bitmap_region(bitmap, width - 1, 0, 1, height, x + width, y, 0);
+
+	al_restore_state(&state);
+	al_hold_bitmap_drawing(held);
+
+	ALLEGRO_BITMAP *region = al_create_sub_bitmap(page->bitmap, x, y, width, height);
+	if (region != nullptr) {
+		this->regions.push_back(region);
+	}
+
+	return region;
+}
+
+size_t TextureAtlas::getPageCount() const {
+	return this->pages.size();
+}
+
+// Find a place for the texture from the current shelf of the page or start a new shelf
+bool TextureAtlas::allocate(Page &page, int width, int height, int &x, int &y) {
+	width += 2 * GUTTER;
+	height += 2 * GUTTER;
+
+	// The page is only changed if the texture fits
+	int shelfX = page.shelfX;
+	int shelfY = page.shelfY;
+	int shelfHeight = page.shelfHeight;
+
+	if (shelfX + width > this->pageSize) {
+		shelfY += shelfHeight;
+		shelfX = 0;
+		shelfHeight = 0;
+	}
+
+	if (shelfY + height > this->pageSize) {
+		return false;
+	}
+
+	x = shelfX + GUTTER;
+	y = shelfY + GUTTER;
+
+	page.shelfX = shelfX + width;
+	page.shelfY = shelfY;
+	page.shelfHeight = std::max(shelfHeight, height);
+
+	return true;
+}
+
+bool TextureAtlas::addPage() {
+	Page page;
+	page.bitmap = al_create_bitmap(this->pageSize, this->pageSize);
+	page.shelfX = 0;
+	page.shelfY = 0;
+	page.shelfHeight = 0;
+
+	if (page.bitmap == nullptr) {
+		return false;
+	}
+
+	const bool held = al_is_bitmap_drawing_held();
+	al_hold_bitmap_drawing(false);
+
+	ALLEGRO_STATE state;
+	al_store_state(&state, ALLEGRO_STATE_TARGET_BITMAP);
+	al_set_target_bitmap(page.bitmap);
+	al_clear_to_color(al_map_rgba(0, 0, 0, 0));
+	al_restore_state(&state);
+
+	al_hold_bitmap_drawing(held);
+
+	this->pages.push_back(page);
+
+	return true;
+}
@@ -0,0 +1,53 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXTUREATLAS_H
+#define TEXTUREATLAS_H
+
+#include <vector>
+#include <algorithm>
+
+#include <allegro5/allegro.h>
+
+// Packs textures into large pages so that drawing any number of them
+// needs only one texture bind per page while bitmap drawing is held.
+class TextureAtlas {
+public:
+	TextureAtlas(int pageSize);
+	~TextureAtlas(void);
+
+	ALLEGRO_BITMAP* add(ALLEGRO_BITMAP *bitmap);
+	size_t getPageCount(void) const;
+
+private:
+	// The pages are filled with shelves of textures from top to bottom
+	struct Page {
+		ALLEGRO_BITMAP *bitmap;
+		int shelfX;
+		int shelfY;
+		int shelfHeight;
+	};
+
+	int pageSize;
+	std::vector<Page> pages;
+	std::vector<ALLEGRO_BITMAP*> regions;
+
+	bool allocate(Page &page, int width, int height, int &x, int &y);
+	bool addPage(void);
+};
+
+#endif
@@ -0,0 +1,225 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "textureLoader.h"
+
+TextureLoader::TextureLoader(unsigned int threadCount)
+: loading(0),
+  stopping(false) {
+	this->mutex = al_create_mutex();
+	this->condition = al_create_cond();
+
+	for (unsigned int i = 0; i < std::max(threadCount, 1u); ++i) {
+		ALLEGRO_THREAD *thread = al_create_thread(&TextureLoader::run, this);
+
+		if (thread != nullptr) {
+			al_start_thread(thread);
+			this->threads.push_back(thread);
+		}
+	}
+}
+
+TextureLoader::~TextureLoader() {
+	al_lock_mutex(this->mutex);
+	this->stopping = true;
+	al_broadcast_cond(this->condition);
+	al_unlock_mutex(this->mutex);
+
+	for (auto &thread : this->threads) {
+		al_join_thread(thread, nullptr);
+		al_destroy_thread(thread);
+	}
+
+	for (auto &result : this->results) {
+		if (result.bitmap != nullptr) {
+			al_destroy_bitmap(result.bitmap);
+		}
+
+		for (auto &level : result.levels) {
+			al_destroy_bitmap(level);
+		}
+	}
+
+	al_destroy_cond(this->condition);
+	al_destroy_mutex(this->mutex);
+}
+
+void TextureLoader::load(std::string texture, std::string path) {
+	Result request;
+	request.texture = texture;
+	request.path = path;
+	request.bitmap = nullptr;
+
+	if (this->threads.empty()) {
+		// The memory bitmaps are made like on the loader threads
+		ALLEGRO_STATE state;
+		al_store_state(&state, ALLEGRO_STATE_NEW_BITMAP_PARAMETERS | ALLEGRO_STATE_NEW_FILE_INTERFACE);
+		al_set_physfs_file_interface();
+		al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+		TextureLoader::decode(request);
+
+		al_restore_state(&state);
+
+		al_lock_mutex(this->mutex);
+		this->results.push_back(request);
+		++this->loading;
+		al_unlock_mutex(this->mutex);
+
+		return;
+	}
+
+	al_lock_mutex(this->mutex);
+	this->queue.push_back(request);
+	++this->loading;
+	al_signal_cond(this->condition);
+	al_unlock_mutex(this->mutex);
+}
+
+// Get the next decoded image
+bool TextureLoader::getResult(Result &result) {
+	al_lock_mutex(this->mutex);
+
+	const bool found = ! this->results.empty();
+	if (found) {
+		result = this->results.front();
+		this->results.pop_front();
+		--this->loading;
+	}
+
+	al_unlock_mutex(this->mutex);
+
+	return found;
+}
+
+bool TextureLoader::isBusy() {
+	al_lock_mutex(this->mutex);
+	const bool busy = this->loading > 0;
+	al_unlock_mutex(this->mutex);
+
+	return busy;
+}
+
+// Scale the bitmap to half of its size by averaging the pixels
+ALLEGRO_BITMAP* TextureLoader::halve(ALLEGRO_BITMAP *bitmap) {
+	const int width = al_get_bitmap_width(bitmap);
+	const int height = al_get_bitmap_height(bitmap);
+	const int halfWidth = std::max(1, width / 2);
+	const int halfHeight = std::max(1, height / 2);
+
+	ALLEGRO_BITMAP *half = al_create_bitmap(halfWidth, halfHeight);
+	if (half == nullptr) {
+		return nullptr;
+	}
+
+	ALLEGRO_LOCKED_REGION *source = al_lock_bitmap(bitmap, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_READONLY);
+	ALLEGRO_LOCKED_REGION *target = al_lock_bitmap(half, ALLEGRO_PIXEL_FORMAT_ABGR_8888_LE, ALLEGRO_LOCK_WRITEONLY);
+
+	if (source != nullptr && target != nullptr) {
+		for (int y = 0; y < halfHeight; ++y) {
+			const unsigned char *row1 = static_cast<const unsigned char*>(source->data) + std::min(2 * y, height - 1) * source->pitch;
+			const unsigned char *row2 = static_cast<const unsigned char*>(source->data) + std::min(2 * y + 1, height - 1) * source->pitch;
+			unsigned char *targetRow = static_cast<unsigned char*>(target->data) + y * target->pitch;
+
+			for (int x = 0; x < halfWidth; ++x) {
+				const int x1 = 4 * std::min(2 * x, width - 1);
+				const int x2 = 4 * std::min(2 * x + 1, width - 1);
+
+				// The alpha is premultiplied, so every channel can be averaged alike
+				for (int channel = 0; channel < 4; ++channel) {
+					targetRow[4 * x + channel] = (row1[x1 + channel] + row1[x2 + channel] + row2[x1 + channel] + row2[x2 + channel] + 2) / 4;
+				}
+			}
+		}
+	}
+
+	if (source != nullptr) {
+		al_unlock_bitmap(bitmap);
+	}
+
+	if (target != nullptr) {
+		al_unlock_bitmap(half);
+	}
+
+	if (source == nullptr || target == nullptr) {
+		al_destroy_bitmap(half);
+		return nullptr;
+	}
+
+	return half;
+}
+
+void* TextureLoader::run(ALLEGRO_THREAD *thread, void *argument) {
+	TextureLoader *loader = static_cast<TextureLoader*>(argument);
+
+	// The file interface and the bitmap flags are thread local
+	al_set_physfs_file_interface();
+	al_set_new_bitmap_flags(ALLEGRO_MEMORY_BITMAP);
+
+	al_lock_mutex(loader->mutex);
+
+	while (true) {
+		while (loader->queue.empty() && ! loader->stopping) {
+			al_wait_cond(loader->condition, loader->mutex);
+		}
+
+		if (loader->stopping) {
+			break;
+		}
+
+		Result result = loader->queue.front();
+		loader->queue.pop_front();
+
+		al_unlock_mutex(loader->mutex);
+
+		TextureLoader::decode(result);
+
+		al_lock_mutex(loader->mutex);
+		loader->results.push_back(result);
+	}
+
+	al_unlock_mutex(loader->mutex);
+
+	return nullptr;
+}
+
+// Decode the image and halve it down to a single pixel
+void TextureLoader::decode(Result &result) {
+	ALLEGRO_FILE *file = al_fopen(result.path.c_str(), "r");
+	if (file != nullptr) {
+		result.bitmap = al_load_bitmap_f(file, result.path.substr(result.path.rfind(".")).c_str());
+		al_fclose(file);
+	}
+
+	if (result.bitmap != nullptr) {
+		ALLEGRO_BITMAP *level = result.bitmap;
+
+		while (al_get_bitmap_width(level) > 1 || al_get_bitmap_height(level) > 1) {
+			level = TextureLoader::halve(level);
+			if (level == nullptr) {
+				break;
+			}
+
+			result.levels.push_back(level);
+		}
+
+		// The single pixel level is the average, unless halving failed before it
+		ALLEGRO_BITMAP *smallest = result.levels.empty() ? result.bitmap : result.levels.back();
+		al_unmap_rgba_f(al_get_pixel(smallest, al_get_bitmap_width(smallest) / 2, al_get_bitmap_height(smallest) / 2),
+		                &result.color.red, &result.color.green, &result.color.blue, &result.color.alpha);
+	}
+}
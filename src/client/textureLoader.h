@@ -0,0 +1,72 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <string>
+
+#include <allegro5/allegro.h>
+#include <allegro5/allegro_physfs.h>
+#include <physfs.h>
+
+#include "../coordinates.h"
+#include "../color.h"
+#include "../utils.h"
+
+// Decodes images into memory bitmaps on worker threads and builds their
+// levels of detail. The finished bitmaps are collected on the render
+// thread, which has to upload them. If no thread could be started, the
+// images are decoded when they are requested.
+class TextureLoader {
+public:
+	struct Result {
+		std::string texture;
+		std::string path;
+		ALLEGRO_BITMAP *bitmap; // nullptr if the image couldn't be decoded
+		std::vector<ALLEGRO_BITMAP*> levels; // Halved until a single pixel
+		Color color; // The average of the pixels, premultiplied by the alpha
+	};
+
+	TextureLoader(unsigned int threadCount);
+	~TextureLoader(void);
+
+	void load(std::string texture, std::string path);
+	bool getResult(Result &result);
+
+	// Whether some of the requested images haven't been collected yet
+	bool isBusy(void);
+
+private:
+	std::vector<ALLEGRO_THREAD*> threads;
+	ALLEGRO_MUTEX *mutex;
+	ALLEGRO_COND *condition;
+
+	std::deque<Result> queue;
+	std::deque<Result> results;
+	unsigned int loading;
+	bool stopping;
+
+	static void* run(ALLEGRO_THREAD *thread, void *argument);
+	static void decode(Result &result);
+	static ALLEGRO_BITMAP* halve(ALLEGRO_BITMAP *bitmap);
+};
+
+#endif
@@ -17,41 +17,74 @@
 
 #include "chatwidget.h"
 
-ChatWidget::ChatWidget(Vector2 location, Vector2 size, float messagetime, ALLEGRO_FONT *font)
+ChatWidget::ChatWidget(Vector2 location, Vector2 size, float messagetime, size_t historySize, ALLEGRO_FONT *font)
 		  : Widget(location, size),
 		    font(font),
-			messageTime(messagetime) { }
+			messageTime(messagetime),
+			lines(std::max(historySize, static_cast<size_t>(1))),
+			firstLine(0),
+			lineCount(0),
+			scrollOffset(0) { }
 
 void ChatWidget::addMessage(Message message) {
-	std::pair<TextArea*, Message> pair(new TextArea(Vector2(this->location.x, this->location.y + this->size.y - 20), this->size,
-										message.message, this->font), message);
-	int messageSize = pair.first->getLineCount();
-	pair.first->move(this->location + Vector2(0.0f, -20.0f * messageSize + this->size.y));
-	for (auto &message : this->messages) {
-		message.first->move(message.first->getLocation() + Vector2(0.0f, -20.0f * messageSize));
+	for (auto &text : TextArea::wrapText(message.message, this->size.x, this->font)) {
+		Line &line = this->lines.at((this->firstLine + this->lineCount) % this->lines.size());
+		line.text = text;
+		line.time = message.time;
+
+		if (this->lineCount < this->lines.size()) {
+			++this->lineCount;
+		} else {
+			this->firstLine = (this->firstLine + 1) % this->lines.size();
+		}
+
+		// Keep the scrolled view where it was
+		if (this->scrollOffset > 0) {
+			this->scroll(1);
+		}
 	}
-	this->messages.push_back(pair);
 }
 
 void ChatWidget::draw(IRenderer *renderer, bool drawAll) {
-float time = al_get_time();
-	for (auto &pair : this->messages) {
-		if (time < pair.second.time + this->messageTime || drawAll) {
-			pair.first->draw(renderer);
+	const double time = al_get_time();
+	const size_t offset = drawAll ? this->scrollOffset : 0;
+	const size_t count = std::min(this->getVisibleLineCount(), this->lineCount - offset);
+
+	for (size_t i = 0; i < count; ++i) {
+		const Line &line = this->getLine(offset + i);
+
+		// The older lines have expired as well
+		if (! drawAll && time >= line.time + this->messageTime) {
+			break;
 		}
+
+		renderer->drawText(line.text, this->location + Vector2(0.0f, this->size.y - LINE_HEIGHT * (i + 1)));
 	}
 }
 
+void ChatWidget::scroll(int lines) {
+	const int maxOffset = std::max(static_cast<int>(this->lineCount) - static_cast<int>(this->getVisibleLineCount()), 0);
+	this->scrollOffset = std::min(std::max(static_cast<int>(this->scrollOffset) + lines, 0), maxOffset);
+}
+
+void ChatWidget::scrollToEnd() {
+	this->scrollOffset = 0;
+}
+
+size_t ChatWidget::getVisibleLineCount() const {
+	return std::max(static_cast<int>(this->size.y) / LINE_HEIGHT, 0);
+}
+
+const ChatWidget::Line& ChatWidget::getLine(size_t age) const {
+	return this->lines.at((this->firstLine + this->lineCount - 1 - age) % this->lines.size());
+}
+
 ChatWidget::~ChatWidget() {
-	for (auto &pair : this->messages) {
-		delete pair.first;
-	}
+
 }
 
+// The lines keep the width they were wrapped to
 void ChatWidget::resize(Vector2 multipler) {
-	Vector2 movement(multipler.x * this->size.x - this->size.x, multipler.y * this->size.y - this->size.y);
 	Widget::resize(multipler);
-	for (auto &pair : this->messages) {
-		pair.first->move(pair.first->getLocation() + Vector2(0.0f, movement.y));
-	}
+	this->scroll(0);
 }
@@ -29,25 +29,45 @@ struct Message {
 	double time;
 };
 
+// Shows the latest chat messages over the game. The messages are wrapped
+// into lines when they arrive and kept in a ring buffer of a fixed number
+// of lines, so the older lines are dropped as new ones come in.
 class ChatWidget : public Widget{
 public:
-	ChatWidget(Vector2 location, Vector2 size, float messagetime, ALLEGRO_FONT *font);
+	ChatWidget(Vector2 location, Vector2 size, float messagetime, size_t historySize, ALLEGRO_FONT *font);
 
 	virtual ~ChatWidget();
 
+	// Every line that fits is drawn with drawAll, otherwise only the recent ones
 	virtual void draw(IRenderer *renderer, bool drawAll = false);
 
 	void addMessage(Message message);
 
+	// Scroll the history by the given amount of lines, positive towards the older lines
+	void scroll(int lines);
+	void scrollToEnd(void);
+	size_t getVisibleLineCount(void) const;
+
 	virtual void resize(Vector2 multipler);
 
 private:
-	std::vector<std::string> text;
+	struct Line {
+		std::string text;
+		double time;
+	};
+
+	static const int LINE_HEIGHT = 20;
+
 	ALLEGRO_FONT *font;
-	int lineCount;
-	std::vector<std::pair<TextArea*, Message>> messages;
 	float messageTime;
 
+	std::vector<Line> lines;
+	size_t firstLine; // The oldest line in the buffer
+	size_t lineCount;
+	size_t scrollOffset; // Lines hidden below the bottom of the widget
+
+	// Age 0 is the latest line
+	const Line& getLine(size_t age) const;
 };
 
 #endif
@@ -21,25 +21,47 @@ TextArea::TextArea(Vector2 location, Vector2 size, std::string text, ALLEGRO_FON
 		  : Widget(location, size),
 		    font(font) {
 
-	this->text = utils::splitString(text, ' ');
-	this->countLines();
+	this->setText(text);
 }
 
-void TextArea::countLines()
-{
-	int lines = 1;
-	int width = 0;
-	for (auto &word : this->text) {
-		int textwidth = al_get_text_width(this->font, word.c_str());
-		if (width + textwidth > this->size.x) {
-			lines++;
-			width = 0;
-		} else {
-			width += al_get_text_width(this->font, " ");
+std::vector<std::string> TextArea::wrapText(const std::string &text, float width, ALLEGRO_FONT *font) {
+	std::vector<std::string> lines;
+	std::string line;
+	float lineWidth = 0.0f;
+	bool empty = true;
+
+	const float spaceWidth = al_get_text_width(font, " ");
+
+	for (auto &word : utils::splitString(text, ' ')) {
+		const float wordWidth = al_get_text_width(font, word.c_str());
+
+		if (! empty && lineWidth + spaceWidth + wordWidth > width) {
+			lines.push_back(line);
+
+			size_t colorPos = line.rfind('^');
+			if (colorPos != std::string::npos) {
+				line = line.substr(colorPos, 4);
+			} else {
+				line = "";
+			}
+
+			lineWidth = 0.0f;
+			empty = true;
 		}
-		width += textwidth;
+
+		if (! empty) {
+			line += ' ';
+			lineWidth += spaceWidth;
+		}
+
+		line += word;
+		lineWidth += wordWidth;
+		empty = false;
 	}
-	this->lineCount = lines;
+
+	lines.push_back(line);
+
+	return lines;
 }
 
 TextArea::~TextArea() {
@@ -47,38 +69,17 @@ TextArea::~TextArea() {
 }
 
 void TextArea::draw(IRenderer *renderer) {
-	Vector2 drawPos(0.0f, 0.0f);
-	std::string tempText;
-	for (auto &word : this->text) {
-		int width = al_get_text_width(this->font, word.c_str());
-		if (width + drawPos.x > this->size.x) {
-
-			renderer->drawText(tempText, this->location + Vector2(0.0f, drawPos.y));
-			size_t colorPos = tempText.rfind('^');
-			if (colorPos != std::string::npos) {
-				tempText = tempText.substr(colorPos, 4);
-			} else {
-				tempText = "";
-			}
-			tempText += word;
-			drawPos.y += 20;
-			drawPos.x = 0;
-		} else {
-			drawPos.x += al_get_text_width(this->font, " ");
-			tempText += word + " ";
-		}
-		drawPos.x += width;
+	for (size_t i = 0; i < this->lines.size(); ++i) {
+		renderer->drawText(this->lines.at(i), this->location + Vector2(0.0f, 20.0f * i));
 	}
-	renderer->drawText(tempText, this->location + Vector2(0.0f, drawPos.y));
 }
 
 int TextArea::getLineCount() {
-	return this->lineCount;
+	return this->lines.size();
 }
 
 void TextArea::setText(std::string text) {
-	this->text = utils::splitString(text, ' ');
-	this->countLines();
+	this->lines = TextArea::wrapText(text, this->size.x, this->font);
 }
 
 void TextArea::move(Vector2 location) {
@@ -33,15 +33,16 @@ public:
 
 	void setText(std::string text);
 
+	// Break the text into lines that fit the width, the colour codes continue on the next lines
+	static std::vector<std::string> wrapText(const std::string &text, float width, ALLEGRO_FONT *font);
+
 	void move(Vector2 location);
 	Vector2 getLocation();
 
 private:
-	void countLines();
-
-	std::vector<std::string> text;
+	// The text is laid out only when it changes
+	std::vector<std::string> lines;
 	ALLEGRO_FONT *font;
-	int lineCount;
 
 };
 
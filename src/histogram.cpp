@@ -0,0 +1,167 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "histogram.h"
+
+Histogram::Histogram()
+: buckets(BUCKETS, 0),
+  count(0),
+  sum(0.0),
+  min(0.0),
+  max(0.0) {}
+
+void Histogram::add(double milliseconds) {
+	if (milliseconds < 0.0) {
+		milliseconds = 0.0;
+	}
+
+	++this->buckets.at(Histogram::getBucket(static_cast<unsigned long long>(milliseconds * 1000.0)));
+
+	if (this->count == 0 || milliseconds < this->min) {
+		this->min = milliseconds;
+	}
+
+	if (this->count == 0 || milliseconds > this->max) {
+		this->max = milliseconds;
+	}
+
+	++this->count;
+	this->sum += milliseconds;
+}
+
+void Histogram::add(const Histogram &histogram) {
+	if (histogram.count == 0) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < BUCKETS; ++i) {
+		this->buckets.at(i) += histogram.buckets.at(i);
+	}
+
+	if (this->count == 0 || histogram.min < this->min) {
+		this->min = histogram.min;
+	}
+
+	if (this->count == 0 || histogram.max > this->max) {
+		this->max = histogram.max;
+	}
+
+	this->count += histogram.count;
+	this->sum += histogram.sum;
+}
+
+void Histogram::clear() {
+	this->buckets.assign(BUCKETS, 0);
+	this->count = 0;
+	this->sum = 0.0;
+	this->min = 0.0;
+	this->max = 0.0;
+}
+
+unsigned int Histogram::getCount() const {
+	return this->count;
+}
+
+double Histogram::getMin() const {
+	return this->min;
+}
+
+double Histogram::getMax() const {
+	return this->max;
+}
+
+double Histogram::getMean() const {
+	if (this->count == 0) {
+		return 0.0;
+	}
+
+	return this->sum / this->count;
+}
+
+// Get the value below which the given percentage of the samples fall
+double Histogram::getPercentile(double percentile) const {
+	if (this->count == 0) {
+		return 0.0;
+	}
+
+	unsigned int target = static_cast<unsigned int>(percentile / 100.0 * this->count + 0.5);
+	if (target < 1) {
+		target = 1;
+	}
+
+	unsigned int seen = 0;
+	for (unsigned int i = 0; i < BUCKETS; ++i) {
+		seen += this->buckets.at(i);
+
+		if (seen >= target) {
+			double value = Histogram::getBucketValue(i) / 1000.0;
+
+			// The bucket midpoint may fall outside of the observed range
+			if (value < this->min) {
+				return this->min;
+			} else if (value > this->max) {
+				return this->max;
+			} else {
+				return value;
+			}
+		}
+	}
+
+	return this->max;
+}
+
+std::string Histogram::getSummary() const {
+	std::ostringstream summary;
+	summary << std::fixed << std::setprecision(2)
+	        << "p50 " << this->getPercentile(50.0) << " ms, "
+	        << "p95 " << this->getPercentile(95.0) << " ms, "
+	        << "p99 " << this->getPercentile(99.0) << " ms, "
+	        << "max " << this->getMax() << " ms (n=" << this->getCount() << ")";
+
+	return summary.str();
+}
+
+unsigned int Histogram::getBucket(unsigned long long microseconds) {
+	if (microseconds < LINEAR_BUCKETS) {
+		return microseconds;
+	}
+
+	unsigned int exponent = 0;
+	while ((microseconds >> (exponent + 1)) != 0) {
+		++exponent;
+	}
+
+	unsigned int bucket = LINEAR_BUCKETS + (exponent - 4) * SUB_BUCKETS + ((microseconds >> (exponent - 3)) & (SUB_BUCKETS - 1));
+
+	if (bucket >= BUCKETS) {
+		return BUCKETS - 1;
+	}
+
+	return bucket;
+}
+
+double Histogram::getBucketValue(unsigned int bucket) {
+	if (bucket < LINEAR_BUCKETS) {
+		return bucket;
+	}
+
+	const unsigned int exponent = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 4;
+	const unsigned long long width = 1ull << (exponent - 3);
+	const unsigned long long lower = (SUB_BUCKETS + (bucket - LINEAR_BUCKETS) % SUB_BUCKETS) * width;
+
+	return lower + width / 2.0;
+}
@@ -0,0 +1,59 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+
+// Fixed memory histogram for durations given in milliseconds. Samples are
+// stored in log-linear buckets with a relative error of at most 1/8.
+class Histogram {
+public:
+	Histogram(void);
+
+	void add(double milliseconds);
+	void add(const Histogram &histogram);
+	void clear(void);
+
+	unsigned int getCount(void) const;
+	double getMin(void) const;
+	double getMax(void) const;
+	double getMean(void) const;
+	double getPercentile(double percentile) const;
+
+	std::string getSummary(void) const;
+
+private:
+	static const unsigned int LINEAR_BUCKETS = 16;
+	static const unsigned int SUB_BUCKETS    = 8;
+	static const unsigned int BUCKETS        = LINEAR_BUCKETS + 36 * SUB_BUCKETS;
+
+	std::vector<unsigned int> buckets;
+	unsigned int count;
+	double sum;
+	double min;
+	double max;
+
+	static unsigned int getBucket(unsigned long long microseconds);
+	static double getBucketValue(unsigned int bucket);
+};
+
+#endif
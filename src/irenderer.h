@@ -37,14 +37,18 @@ public:
 	virtual void setWindowTitle(std::string title, std::string icon) = 0;
 	virtual void updateTransformations(void) = 0;
 
+	virtual float getScreenScale(void) const = 0;
 	virtual void zoomScreen(float zoom) = 0;
 	virtual void scrollScreen(Vector2 translation) = 0;
 	virtual void rotateScreen(float angle) = 0;
 	virtual void setScreenSize(Coordinates screenSize) = 0;
 
-	virtual void drawBitmap(std::string texture, Vector2 dest_location, Vector2 dest_size, float angle = 0) = 0;
+	// Resolve a texture name to the handle used by the drawing functions
+	virtual unsigned int getTexture(std::string texture) = 0;
 
-	virtual void drawBitmapTinted(std::string texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle = 0) = 0;
+	virtual void drawBitmap(unsigned int texture, Vector2 dest_location, Vector2 dest_size, float angle = 0) = 0;
+
+	virtual void drawBitmapTinted(unsigned int texture, Vector2 dest_location, Vector2 dest_size, Color color, float angle = 0) = 0;
 
 	virtual void drawLine(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI) = 0;
 
@@ -56,9 +60,15 @@ public:
 
 	virtual void drawText(std::string text, Vector2 location, Alignment alignment = Alignment::LEFT) = 0;
 
-	virtual Coordinates getTextureSize(std::string texture) = 0;
+	// The overlay primitives are collected and drawn together on top of everything by drawOverlay
+	virtual void addOverlayRectangle(Vector2 pointA, Vector2 pointB, Color color, float thickness, Transformation transformation = Transformation::UI) = 0;
+	virtual void addOverlayRectangleFilled(Vector2 pointA, Vector2 pointB, Color color) = 0;
+	virtual void drawOverlay(void) = 0;
+
+	virtual Coordinates getTextureSize(unsigned int texture) = 0;
 
 	virtual void transformLocation(Transformation transformation, Vector2 &location) = 0;
+	virtual void getViewBounds(Vector2 &min, Vector2 &max) = 0;
 	virtual void useTransformation(Transformation transformation) = 0;
 
 	virtual void hsvToRgb(float hue, float saturation, float value, Color *color) = 0;
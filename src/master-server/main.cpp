@@ -48,28 +48,15 @@ MasterServer::MasterServer(unsigned int port) {
 
 	this->settings = new Settings("master-server.cfg");
 
+	this->queryReply = nullptr;
 	this->exiting = false;
-
-	// Add two test servers
-	{
-		ServerRecord *test = new ServerRecord;
-		test->address = "1.1.1.1";
-		test->port = 13355;
-		test->name = "Test server";
-		test->players = 54;
-		this->servers.push_back(test);
-	}
-	{
-		ServerRecord *test = new ServerRecord;
-		test->address = "example.com";
-		test->port = 12345;
-		test->name = "Card game";
-		test->players = 0;
-		this->servers.push_back(test);
-	}
 }
 
 MasterServer::~MasterServer() {
+	for (auto &server : this->servers) {
+		delete server.second;
+	}
+
 	delete this->settings;
 }
 
@@ -79,6 +66,8 @@ int MasterServer::run() {
 		this->address.port = this->settings->getValue<int>("network.port");
 	}
 
+	this->timeToLive = this->settings->getValue<int>("network.ttl") * 1000;
+
 	// Catch SIGINT
 	signal(SIGINT, catchSignal);
 
@@ -108,6 +97,8 @@ int MasterServer::run() {
 void MasterServer::mainLoop() {
 	while (! this->exiting) {
 		this->networkEvents();
+
+		this->expireServers();
 	}
 }
 
@@ -116,6 +107,8 @@ void MasterServer::exit() {
 }
 
 void MasterServer::dispose() {
+	this->invalidateServerList();
+
 	enet_host_destroy(this->connection);
 	enet_deinitialize();
 }
@@ -129,6 +122,9 @@ void MasterServer::networkEvents() {
 			case ENET_EVENT_TYPE_CONNECT: {
 				std::cout << "A new connection from " << net::AddressToString(event.peer->address) << "." << std::endl;
 
+				// The peer gets a server record when it registers
+				event.peer->data = nullptr;
+
 				// Set ping interval for the connection, this is only supported in ENet >= 1.3.4
 				#if ENET_VERSION >= ENET_VERSION_CREATE(1, 3, 4)
 				enet_peer_ping_interval(event.peer, net::MASTER_SERVER_PING_INTERVAL);
@@ -146,7 +142,13 @@ void MasterServer::networkEvents() {
 			}
 
 			case ENET_EVENT_TYPE_DISCONNECT: {
-				std::cout << "Client disconnected!" << std::endl;
+				// Forget the servers right away when they disconnect
+				if (event.peer->data != nullptr) {
+					ServerRecord *server = static_cast<ServerRecord*>(event.peer->data);
+					std::cout << "Server " << server->address << ":" << server->port << " disconnected." << std::endl;
+
+					this->removeServer(server);
+				}
 
 				break;
 			}
@@ -164,41 +166,18 @@ void MasterServer::receivePacket(ENetEvent event) {
 	try {
 		switch (packet.readHeader()) {
 			case Packet::Header::MS_QUERY: {
-				Packet reply(event.peer);
-				reply.writeHeader(Packet::Header::MS_QUERY);
-
-				for (auto &server : this->servers) {
-					reply.writeString(server->address);
-					reply.writeShort(server->port);
-					reply.writeString(server->name);
-					reply.writeShort(server->players);
-				}
-
-				reply.send();
-
-				std::cout << "Sent the server list." << std::endl;
-
-				break;
-			}
-
-			case Packet::Header::MS_REGISTER: {
-				ServerRecord *server = new ServerRecord;
-				server->address = net::IPIntegerToString(event.peer->address.host);
-				server->port = packet.readShort();
-				server->name = packet.readString();
-				server->players = packet.readShort();
-				server->peer = event.peer;
-				this->servers.push_back(server);
+				ServerQuery query;
+				query.read(packet);
 
-				std::cout << "Added a new server to the list." << std::endl;
+				this->sendServerList(event.peer, query);
 
 				break;
 			}
 
+			case Packet::Header::MS_REGISTER:
 			case Packet::Header::MS_UPDATE: {
-				std::cout << "A server wants to refresh its information!" << std::endl;
-
-				// TODO: Update the server information
+				// Both register a new server or refresh an old one
+				this->updateServer(event.peer, packet);
 
 				break;
 			}
@@ -223,3 +202,182 @@ void MasterServer::receivePacket(ENetEvent event) {
 				  << ": \"" << e.what() << "\"" << std::endl;
 	}
 }
+
+// Add or refresh the information of the server behind the peer
+void MasterServer::updateServer(ENetPeer *peer, Packet &packet) {
+	const unsigned short port = packet.readShort();
+	const std::string name = packet.readString();
+	const unsigned short players = packet.readShort();
+
+	// Older servers don't tell their capacity and packages
+	unsigned short slots = 65535;
+	std::set<std::string> packages;
+
+	if (! packet.eof()) {
+		slots = packet.readShort();
+
+		unsigned short packageCount = packet.readShort();
+		for (unsigned short i = 0; i < packageCount; ++i) {
+			packages.insert(packet.readString());
+		}
+	}
+
+	const std::string address = net::IPIntegerToString(peer->address.host);
+	const std::string key = address + ":" + utils::toString(port);
+
+	ServerRecord *server;
+	auto record = this->servers.find(key);
+
+	if (record == this->servers.end()) {
+		// A peer only has one server on the list
+		if (peer->data != nullptr) {
+			this->removeServer(static_cast<ServerRecord*>(peer->data));
+		}
+
+		server = new ServerRecord;
+		server->address = address;
+		server->port = port;
+		server->name = name;
+		server->players = players;
+		server->slots = slots;
+		server->packages = packages;
+		server->expires = 0;
+		this->servers[key] = server;
+
+		this->invalidateServerList();
+
+		std::cout << "Added " << key << " to the server list." << std::endl;
+	} else {
+		server = record->second;
+		this->expiryQueue.erase(std::make_pair(server->expires, key));
+
+		if (peer->data != nullptr && peer->data != server) {
+			this->removeServer(static_cast<ServerRecord*>(peer->data));
+		}
+
+		if (server->name != name || server->players != players || server->slots != slots || server->packages != packages) {
+			server->name = name;
+			server->players = players;
+			server->slots = slots;
+			server->packages = packages;
+
+			this->invalidateServerList();
+		}
+	}
+
+	server->lowerCaseName = server->name;
+	for (auto &character : server->lowerCaseName) {
+		character = std::tolower(static_cast<unsigned char>(character));
+	}
+
+	// A server that registers again from a new peer is no longer owned by the
+	// old one, which would remove it when disconnecting
+	if (server->peer != nullptr && server->peer != peer && server->peer->data == server) {
+		server->peer->data = nullptr;
+	}
+
+	server->peer = peer;
+	peer->data = server;
+
+	server->expires = enet_time_get() + this->timeToLive;
+	this->expiryQueue.insert(std::make_pair(server->expires, key));
+}
+
+void MasterServer::removeServer(ServerRecord *server) {
+	const std::string key = server->address + ":" + utils::toString(server->port);
+
+	this->expiryQueue.erase(std::make_pair(server->expires, key));
+	this->servers.erase(key);
+
+	if (server->peer != nullptr && server->peer->data == server) {
+		server->peer->data = nullptr;
+	}
+
+	delete server;
+
+	this->invalidateServerList();
+}
+
+// Remove the servers that haven't sent a heartbeat in time
+void MasterServer::expireServers() {
+	const enet_uint32 time = enet_time_get();
+
+	while (! this->expiryQueue.empty() && this->expiryQueue.begin()->first <= time) {
+		ServerRecord *server = this->servers.find(this->expiryQueue.begin()->second)->second;
+
+		std::cout << "Server " << server->address << ":" << server->port << " expired." << std::endl;
+
+		this->removeServer(server);
+	}
+}
+
+void MasterServer::sendServerList(ENetPeer *peer, const ServerQuery &query) {
+	if (! query.isDefault()) {
+		enet_peer_send(peer, 0, this->createServerList(peer, query));
+		return;
+	}
+
+	if (this->queryReply == nullptr) {
+		// Keep a reference of our own to share the packet with all the default queries
+		this->queryReply = this->createServerList(peer, query);
+		++this->queryReply->referenceCount;
+	}
+
+	enet_peer_send(peer, 0, this->queryReply);
+}
+
+// Evaluate the query against the registry and serialize one page of the results
+ENetPacket* MasterServer::createServerList(ENetPeer *peer, const ServerQuery &query) const {
+	std::vector<ServerRecord*> results;
+
+	for (auto &server : this->servers) {
+		if (query.matches(server.second->lowerCaseName, server.second->players, server.second->slots, server.second->packages)) {
+			results.push_back(server.second);
+		}
+	}
+
+	auto compare = [&query](const ServerRecord *a, const ServerRecord *b) -> bool {
+		if (query.descending) {
+			std::swap(a, b);
+		}
+
+		switch (query.sort) {
+			case ServerQuery::Sort::PLAYERS:
+				return a->players < b->players;
+			case ServerQuery::Sort::FREE_SLOTS:
+				return a->slots - a->players < b->slots - b->players;
+			default:
+				return a->lowerCaseName < b->lowerCaseName;
+		}
+	};
+
+	// Only the servers up to the end of the page need to be in order
+	const size_t first = std::min(static_cast<size_t>(query.cursor), results.size());
+	const size_t last = std::min(first + query.pageSize, results.size());
+	std::partial_sort(results.begin(), results.begin() + last, results.end(), compare);
+
+	Packet reply(peer);
+	reply.writeHeader(Packet::Header::MS_QUERY);
+	reply.writeShort(results.size());
+	reply.writeShort(last < results.size() ? last : 0); // The cursor of the next page
+
+	for (size_t i = first; i < last; ++i) {
+		reply.writeString(results.at(i)->address);
+		reply.writeShort(results.at(i)->port);
+		reply.writeString(results.at(i)->name);
+		reply.writeShort(results.at(i)->players);
+		reply.writeShort(results.at(i)->slots);
+	}
+
+	return reply.createENetPacket();
+}
+
+void MasterServer::invalidateServerList() {
+	if (this->queryReply != nullptr) {
+		if (--this->queryReply->referenceCount == 0) {
+			enet_packet_destroy(this->queryReply);
+		}
+
+		this->queryReply = nullptr;
+	}
+}
@@ -21,7 +21,13 @@
 
 #include <cstdlib>
 #include <csignal>
+#include <map>
+#include <set>
+#include <vector>
+#include <cctype>
+#include <algorithm>
 #include <string>
+#include <utility>
 #include <iostream>
 
 #include <enet/enet.h>
@@ -30,8 +36,9 @@
 #include "../packet.h"
 #include "../net.h"
 #include "../settings.h"
+#include "../serverQuery.h"
 
-const unsigned int MAX_CONNECTIONS = 255;
+const unsigned int MAX_CONNECTIONS = 4095;
 
 class MasterServer;
 
@@ -58,11 +65,21 @@ private:
 		std::string address;    // Hostname or IP-address
 		unsigned short port;    // The connection port
 		std::string name;       // The name of the server
+		std::string lowerCaseName;
 		unsigned short players; // The amount of players on the server
+		unsigned short slots;   // The maximum amount of players
+		std::set<std::string> packages;
 		ENetPeer *peer;         // The connected server
+		enet_uint32 expires;    // The time of expiry if not refreshed
 	};
 
-	std::vector<ServerRecord*> servers;
+	// The registered servers by "address:port" and their expiry times
+	std::map<std::string, ServerRecord*> servers;
+	std::set<std::pair<enet_uint32, std::string>> expiryQueue;
+	enet_uint32 timeToLive;
+
+	// The default server list is serialized only after it has changed
+	ENetPacket *queryReply;
 
 	bool exiting;
 
@@ -71,6 +88,13 @@ private:
 
 	void networkEvents(void);
 	void receivePacket(ENetEvent event);
+
+	void updateServer(ENetPeer *peer, Packet &packet);
+	void removeServer(ServerRecord *server);
+	void expireServers(void);
+	void sendServerList(ENetPeer *peer, const ServerQuery &query);
+	ENetPacket* createServerList(ENetPeer *peer, const ServerQuery &query) const;
+	void invalidateServerList(void);
 };
 
 #endif
@@ -21,8 +21,8 @@
 #include <iomanip>
 
 // Check if a nick is already used
-bool net::isNickTaken(std::map<unsigned char, ServerClient*> clients, std::string nick) {
-	for (std::map<unsigned char, ServerClient*>::iterator client = clients.begin(); client != clients.end(); ++client) {
+bool net::isNickTaken(const std::map<unsigned char, ServerClient*> &clients, std::string nick) {
+	for (std::map<unsigned char, ServerClient*>::const_iterator client = clients.begin(); client != clients.end(); ++client) {
 		if (client->second->isJoined() && client->second->getNick().compare(nick) == 0) {
 			return true;
 		}
@@ -35,13 +35,16 @@ class Object;
 namespace net {
 	// Define basic connection parameters
 	const unsigned int CHANNELS      = 2;
-	const unsigned char MAX_CLIENTS  = 32;
+	const unsigned int MAX_PLAYERS   = 255; // Players are identified by a single byte
+	const unsigned char NO_CLIENT    = 255; // Client id of the server and of spectators in commands
+	const unsigned short FIRST_SPECTATOR_ID = 256;
 	const float MAX_FLOAT            = 10000.0f;
 	const double STREAM_INTERVAL     = 5000.0f;
 	const unsigned int PING_INTERVAL = 1000;
 
 	// Master server options
 	const unsigned int MASTER_SERVER_PING_INTERVAL = 60000;
+	const unsigned int MASTER_SERVER_HEARTBEAT_INTERVAL = 60000;
 
 	// >>> DEPRECATED: Use Packet instead
 	// Client control packets
@@ -73,7 +76,7 @@ namespace net {
 	const unsigned char PACKET_PINGS = 0xE0; // Broadcast ping information
 	// <<< DEPRECATED
 
-	bool isNickTaken(std::map<unsigned char, ServerClient*> clients, std::string nick);
+	bool isNickTaken(const std::map<unsigned char, ServerClient*> &clients, std::string nick);
 
 	// >>> DEPRECATED: Use Packet instead
 	void sendCommand(ENetHost *connection, const char *data, size_t length, bool isReliable=true);
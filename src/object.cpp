@@ -18,6 +18,25 @@
 
 #include "object.h"
 
+namespace {
+	// The rotations are multiples of pi / 8, so their cosines come from a table.
+	// The sine of step n is the cosine of step n - 4.
+	const int ROTATION_STEPS = 16;
+	constexpr float ROTATION_COSINES[ROTATION_STEPS] = {
+		 1.0f,  0.9238795f,  0.7071068f,  0.3826834f,  0.0f, -0.3826834f, -0.7071068f, -0.9238795f,
+		-1.0f, -0.9238795f, -0.7071068f, -0.3826834f,  0.0f,  0.3826834f,  0.7071068f,  0.9238795f
+	};
+
+	float dot(const Vector2 &a, const Vector2 &b) {
+		return a.x * b.x + a.y * b.y;
+	}
+
+	// The radius of a box projected on an axis
+	float projectBox(const Vector2 &halfSize, const Vector2 &axisX, const Vector2 &axisY, const Vector2 &axis) {
+		return halfSize.x * std::abs(dot(axisX, axis)) + halfSize.y * std::abs(dot(axisY, axis));
+	}
+}
+
 Object::Object(ObjectClass *objectClass, std::string objectId, unsigned int id, Vector2 location) {
 	this->objectClass = objectClass;
 	this->objectId    = objectId;
@@ -30,14 +49,29 @@ Object::Object(ObjectClass *objectClass, std::string objectId, unsigned int id,
 	this->scale       = 1.0f;
 
 	this->image = this->objectClass->getPackage() + "/objects/" + this->objectClass->getObjectClass() + "/" + this->objectId;
+	this->texture = 0;
+	this->flipsideTexture = 0;
 	this->stackDelta = Vector2(4.0f, 0.0f);
 
-	this->animationTime = 0.0f;
+	this->animating = false;
+	this->rotationOffset = 0.0f;
+	this->flipPhase = 0.0f;
+
+	this->updateBox();
 }
 
 void Object::initForClient(IRenderer *renderer) {
-	Coordinates textureSize = renderer->getTextureSize(this->image);
+	this->texture = renderer->getTexture(this->image);
+
+	if (this->objectClass->getFlipsideImage().empty()) {
+		this->flipsideTexture = this->texture;
+	} else {
+		this->flipsideTexture = renderer->getTexture(this->objectClass->getFlipsideImage());
+	}
+
+	Coordinates textureSize = renderer->getTextureSize(this->texture);
 	this->size = Vector2(textureSize.x, textureSize.y);
+	this->updateBox();
 }
 
 ObjectClass* Object::getObjectClass() const {
@@ -61,7 +95,7 @@ Vector2 Object::getLocation() const {
 }
 
 Vector2 Object::getTargetLocation() const {
-	if (this->animationTime > 0.0f) {
+	if (this->animating) {
 		return this->animationTarget;
 	} else {
 		return this->location;
@@ -94,44 +128,53 @@ float Object::getRotation() const {
 	return this->rotation;
 }
 
+// The axis aligned box around the rotated object at its current location
+void Object::getBounds(Vector2 &min, Vector2 &max) const {
+	const Vector2 extent(projectBox(this->boxHalfSize, this->boxAxisX, this->boxAxisY, Vector2(1.0f, 0.0f)),
+	                     projectBox(this->boxHalfSize, this->boxAxisX, this->boxAxisY, Vector2(0.0f, 1.0f)));
+
+	min = this->location - extent;
+	max = this->location + extent;
+}
+
 bool Object::testLocation(Vector2 location) const {
-	const Vector2 targetLocation = this->getTargetLocation();
-	const Vector2 rotatedSize = (this->getSize() * this->objectClass->getScale() * this->scale / 2.0f).rotate(this->rotation);
-	const float rotatedSizeAbsX = std::abs(rotatedSize.x);
-	const float rotatedSizeAbsY = std::abs(rotatedSize.y);
-
-	if (location.x >= targetLocation.x - rotatedSizeAbsX
-			&& location.x <= targetLocation.x + rotatedSizeAbsX
-			&& location.y >= targetLocation.y - rotatedSizeAbsY
-			&& location.y <= targetLocation.y + rotatedSizeAbsY) {
-		return true;
-	} else {
-		return false;
-	}
+	const Vector2 delta = location - this->boxCenter;
+
+	return std::abs(dot(delta, this->boxAxisX)) <= this->boxHalfSize.x
+	       && std::abs(dot(delta, this->boxAxisY)) <= this->boxHalfSize.y;
 }
 
-bool Object::testCollision(const Object *object, bool second) const {
-	const Vector2 targetLocation = this->getTargetLocation();
-	const Vector2 rotatedSize = (this->getSize() * this->objectClass->getScale() * this->scale / 2.0f).rotate(this->rotation);
-	const float rotatedSizeAbsX = std::abs(rotatedSize.x);
-	const float rotatedSizeAbsY = std::abs(rotatedSize.y);
+// The oriented box at the target location
+void Object::getBox(Vector2 &center, Vector2 &halfSize, Vector2 &axis) const {
+	center = this->boxCenter;
+	halfSize = this->boxHalfSize;
+	axis = this->boxAxisX;
+}
 
-	// Check if any of the object's corners is inside the other object and then vice versa.
-	if (object->testLocation(targetLocation - rotatedSize)
-			|| object->testLocation(targetLocation + rotatedSize)
-			|| object->testLocation(Vector2(targetLocation.x - rotatedSizeAbsX, targetLocation.y + rotatedSizeAbsY))
-			|| object->testLocation(Vector2(targetLocation.x + rotatedSizeAbsX, targetLocation.y - rotatedSizeAbsY))
-			|| (! second && object->testCollision(this, true))) {
-		return true;
-	} else {
-		return false;
+// Separating axis test of the oriented boxes, the edge normals of both
+// boxes are the only candidates for a separating axis in 2D.
+bool Object::testCollision(const Object *object) const {
+	const Vector2 delta = object->boxCenter - this->boxCenter;
+	const Vector2 axes[4] = {this->boxAxisX, this->boxAxisY, object->boxAxisX, object->boxAxisY};
+
+	for (auto &axis : axes) {
+		if (std::abs(dot(delta, axis)) > projectBox(this->boxHalfSize, this->boxAxisX, this->boxAxisY, axis)
+		                                 + projectBox(object->boxHalfSize, object->boxAxisX, object->boxAxisY, axis)) {
+			return false;
+		}
 	}
+
+	return true;
 }
 
 bool Object::isUnder() const {
 	return ! this->objectsAbove.empty();
 }
 
+const std::list<Object*>& Object::getObjectsDirectlyAbove() const {
+	return this->objectsAbove;
+}
+
 Vector2 Object::getStackDelta() const {
 	return this->stackDelta;
 }
@@ -168,15 +211,14 @@ std::list<Object*> Object::getObjectsAbove(std::set<Object*> &visited) {
 	return allAbove;
 }
 
-bool Object::checkIfUnder(std::vector<Object*> objectOrder) {
+// The overlaps are the indices of the colliding objects above this one in the object order
+bool Object::checkIfUnder(const std::vector<Object*> &objectOrder, const std::vector<size_t> &overlaps) {
 	this->objectsAbove.clear();
-	bool thisFound = false;
-	for (auto &object : objectOrder) {
-		if (! thisFound) {
-			if (object->getId() == this->getId()) {
-				thisFound = true;
-			}
-		} else if (object->owner == this->owner && this->testCollision(object)) {
+
+	for (auto &index : overlaps) {
+		Object *object = objectOrder.at(index);
+
+		if (object->owner == this->owner) {
 			this->objectsAbove.push_back(object);
 		}
 	}
@@ -210,6 +252,7 @@ bool Object::isFlipped() const {
 
 void Object::setLocation(Vector2 location) {
 	this->location = location;
+	this->updateBoxCenter();
 }
 
 void Object::select(Client* client) {
@@ -234,33 +277,37 @@ void Object::setFlipped(bool flipped) {
 	this->flipped = flipped;
 }
 
-void Object::setAnimation(Vector2 target, float time) {
+void Object::setAnimationTarget(Vector2 target) {
 	this->animationTarget = target;
-	this->animationTime = time;
+	this->animating = true;
+	this->updateBoxCenter();
 }
 
-void Object::animate(double deltaTime) {
-	if (this->animationTime > 0.0f) {
-		const float distance = this->location.dst(this->animationTarget);
-		const float speed = distance / this->animationTime;
+void Object::endAnimation() {
+	this->animating = false;
+	this->updateBoxCenter();
+}
 
-		if (distance < speed * deltaTime || distance <= 0.002f) {
-			this->location = this->animationTarget;
-			this->animationTime = 0.0f;
-		} else {
-			this->location += speed * deltaTime * (this->animationTarget - this->location).nor();
-			this->animationTime -= deltaTime;
-		}
-	}
+bool Object::isAnimating() const {
+	return this->animating;
+}
+
+float Object::getRotationOffset() const {
+	return this->rotationOffset;
+}
+
+void Object::setRotationOffset(float offset) {
+	this->rotationOffset = offset;
+}
+
+void Object::setFlipPhase(float phase) {
+	this->flipPhase = phase;
 }
 
 void Object::draw(IRenderer *renderer, Client *localClient) const {
-	std::string image;
-	if ((! this->flipped && (this->owner == nullptr || this->owner == localClient)) || this->objectClass->getFlipsideImage().empty()) {
-		image = this->image;
-	} else {
-		image = this->objectClass->getFlipsideImage();
-	}
+	// The image narrows down to an edge and widens again during a flip
+	const float flipScale = std::max(std::abs(1.0f - 2.0f * this->flipPhase), 0.01f);
+	const unsigned int texture = this->getDrawnTexture(localClient);
 
 	Color tint(1.0f, 1.0f, 1.0f, 1.0f);
 
@@ -272,15 +319,23 @@ void Object::draw(IRenderer *renderer, Client *localClient) const {
 
 	float scale = this->scale * this->objectClass->getScale();
 
+	renderer->drawBitmapTinted(texture, this->location, this->getSize() * scale * Vector2(flipScale, 1.0f), tint,
+	                           this->rotation + this->rotationOffset);
+
+	this->drawMarkers(renderer);
+}
+
+// The markers are drawn in one go after all objects to keep the sprites batched
+void Object::drawMarkers(IRenderer *renderer) const {
+	Vector2 corners[4];
+
 	if (this->selected != nullptr) {
-		const std::vector<Vector2> corners = this->getCorners(true, 1.0f);
-		renderer->drawRectangle(corners.at(0), corners.at(1), this->selected->getColor(), 2.0f, IRenderer::Transformation::CAMERA);
+		this->getCorners(corners, 1.0f);
+		renderer->addOverlayRectangle(corners[0], corners[2], this->selected->getColor(), 2.0f, IRenderer::Transformation::CAMERA);
 	}
 
-	renderer->drawBitmapTinted(image, this->location, this->getSize() * scale, tint, this->rotation);
-
 	if (this->owner != nullptr) {
-		const std::vector<Vector2> corners = this->getCorners(true);
+		this->getCorners(corners);
 
 		Color indicatorColor = this->owner->getColor();
 		float alpha = 0.2f;
@@ -288,37 +343,34 @@ void Object::draw(IRenderer *renderer, Client *localClient) const {
 		indicatorColor.green *= alpha;
 		indicatorColor.blue *= alpha;
 		indicatorColor.alpha = alpha;
-		renderer->drawRectangleFilled(corners.at(0), corners.at(1), indicatorColor, IRenderer::Transformation::CAMERA);
+		renderer->addOverlayRectangleFilled(corners[0], corners[2], indicatorColor);
 	}
 }
 
-void Object::rotate(float angle) {
-	this->rotation += angle;
-}
-
-const std::vector<Vector2> Object::getCorners(bool onlyDiagonal, float margin) const {
-	const float scale = this->scale * this->objectClass->getScale();
-	const Vector2 rotatedSize1 = (Vector2(this->size.x * scale + margin, this->size.y * scale + margin) / 2.0f).rotate(this->rotation);
-	Vector2 rotatedSize2;
+// The side of the object that is currently visible to the local player
+unsigned int Object::getDrawnTexture(Client *localClient) const {
+	const bool flipped = this->flipPhase > 0.0f && this->flipPhase < 0.5f ? ! this->flipped : this->flipped;
 
-	if (!onlyDiagonal) {
-		rotatedSize2 = (Vector2(this->size.x * scale + margin, -(this->size.y * scale + margin)) / 2.0f).rotate(this->rotation);
-	}
-
-	std::vector<Vector2> corners;
-	corners.push_back(this->getLocation() + rotatedSize1);
-
-	if (!onlyDiagonal) {
-		corners.push_back(this->getLocation() + rotatedSize2);
+	if (! flipped && (this->owner == nullptr || this->owner == localClient)) {
+		return this->texture;
+	} else {
+		return this->flipsideTexture;
 	}
+}
 
-	corners.push_back(this->getLocation() - rotatedSize1);
+void Object::rotate(float angle) {
+	this->rotation += angle;
+	this->updateBox();
+}
 
-	if (!onlyDiagonal) {
-		corners.push_back(this->getLocation() - rotatedSize2);
-	}
+void Object::getCorners(Vector2 (&corners)[4], float margin) const {
+	const Vector2 halfX = this->boxAxisX * (this->boxHalfSize.x + margin / 2.0f);
+	const Vector2 halfY = this->boxAxisY * (this->boxHalfSize.y + margin / 2.0f);
 
-	return corners;
+	corners[0] = this->location + halfX + halfY;
+	corners[1] = this->location + halfX - halfY;
+	corners[2] = this->location - halfX - halfY;
+	corners[3] = this->location - halfX + halfY;
 }
 
 float Object::getScale(void) const {
@@ -327,5 +379,31 @@ float Object::getScale(void) const {
 void Object::setScale(float newScale) {
 	if (newScale > 0.0f) {
 		this->scale = newScale;
+		this->updateBox();
 	}
 }
+
+void Object::updateBox() {
+	const float step = this->rotation / (utils::PI / 8.0f);
+	const long rounded = std::lround(step);
+	float cosine;
+	float sine;
+
+	if (std::abs(step - rounded) < 0.001f) {
+		const int index = (rounded % ROTATION_STEPS + ROTATION_STEPS) % ROTATION_STEPS;
+		cosine = ROTATION_COSINES[index];
+		sine = ROTATION_COSINES[(index + ROTATION_STEPS - 4) % ROTATION_STEPS];
+	} else {
+		cosine = std::cos(this->rotation);
+		sine = std::sin(this->rotation);
+	}
+
+	this->boxHalfSize = this->size * this->objectClass->getScale() * this->scale / 2.0f;
+	this->boxAxisX = Vector2(cosine, sine);
+	this->boxAxisY = Vector2(-sine, cosine);
+	this->updateBoxCenter();
+}
+
+void Object::updateBoxCenter() {
+	this->boxCenter = this->getTargetLocation();
+}
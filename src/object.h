@@ -23,11 +23,13 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <algorithm>
 
 #include <cmath>
 
 #include "irenderer.h"
 #include "vector2.h"
+#include "utils.h"
 #include "objectClass.h"
 #include "client.h"
 
@@ -46,13 +48,16 @@ public:
 	Vector2 getSize(void) const;
 	Vector2 getGridSize(void) const;
 	float getRotation(void) const;
+	void getBounds(Vector2 &min, Vector2 &max) const;
 	bool testLocation(Vector2 location) const;
-	bool testCollision(const Object *object, bool second = false) const;
+	bool testCollision(const Object *object) const;
+	void getBox(Vector2 &center, Vector2 &halfSize, Vector2 &axis) const;
 
 	bool isUnder(void) const;
+	const std::list<Object*>& getObjectsDirectlyAbove(void) const;
 	Vector2 getStackDelta(void) const;
 	std::list<Object*> getObjectsAbove(std::set<Object*> &visited);
-	bool checkIfUnder(std::vector<Object*> objectOrder);
+	bool checkIfUnder(const std::vector<Object*> &objectOrder, const std::vector<size_t> &overlaps);
 	bool isSelectedBy(Client *client) const;
 	Client* getSelected(void);
 	bool isOwnedBy(Client *client) const;
@@ -64,16 +69,30 @@ public:
 	void setOwner(Client *client);
 	void flip(void);
 	void setFlipped(bool flipped);
-	void setAnimation(Vector2 target, float time);
 
-	void animate(double deltaTime);
+	// The location is animated towards the target, which the collision
+	// tests already use
+	void setAnimationTarget(Vector2 target);
+	void endAnimation(void);
+	bool isAnimating(void) const;
+
+	// The drawn rotation differs from the rotation by the offset
+	float getRotationOffset(void) const;
+	void setRotationOffset(float offset);
+
+	// Between 0 and 1 during a flip, the old side is drawn for the first half
+	void setFlipPhase(float phase);
+
 	void draw(IRenderer *renderer, Client *localClient) const;
+	void drawMarkers(IRenderer *renderer) const;
+	unsigned int getDrawnTexture(Client *localClient) const;
 	void rotate(float angle);
 
 	float getScale(void) const;
 	void setScale(float);
 
-	const std::vector<Vector2> getCorners(bool onlyDiagonal = false, float margin = 0.0f) const;
+	// The corners around the current location, the diagonal ones are 0 and 2
+	void getCorners(Vector2 (&corners)[4], float margin = 0.0f) const;
 
 private:
 	ObjectClass *objectClass;
@@ -84,6 +103,8 @@ private:
 	bool flipped;
 	std::string image;
 	std::string backside;
+	unsigned int texture;
+	unsigned int flipsideTexture;
 	Vector2 stackDelta;
 	float rotation;
 	float scale;
@@ -93,7 +114,19 @@ private:
 	std::list<Object*> objectsAbove;
 
 	Vector2 animationTarget;
-	float animationTime;
+	bool animating;
+	float rotationOffset;
+	float flipPhase;
+
+	// The oriented box of the object at its target location, kept up to date
+	// for the collision tests
+	Vector2 boxCenter;
+	Vector2 boxHalfSize;
+	Vector2 boxAxisX;
+	Vector2 boxAxisY;
+
+	void updateBox(void);
+	void updateBoxCenter(void);
 };
 
 #endif
@@ -25,18 +25,73 @@ PacketException::PacketException(std::string message)
 Packet::Packet(ENetHost *connection, bool isReliable)
 : connection(connection),
   peer(nullptr),
+  group(nullptr),
   isReliable(isReliable) {}
 
 Packet::Packet(ENetPeer *peer, bool isReliable)
 : connection(nullptr),
   peer(peer),
+  group(nullptr),
+  isReliable(isReliable) {}
+
+Packet::Packet(BroadcastGroup *group, bool isReliable)
+: connection(nullptr),
+  peer(nullptr),
+  group(group),
   isReliable(isReliable) {}
 
 Packet::Packet(ENetPacket *packet)
-: readCursor(0) {
+: readCursor(0),
+  connection(nullptr),
+  peer(nullptr),
+  group(nullptr),
+  isReliable(true) {
 	this->data.assign(reinterpret_cast<char*>(packet->data), packet->dataLength);
 }
 
+Packet::Packet(bool isReliable)
+: connection(nullptr),
+  peer(nullptr),
+  group(nullptr),
+  isReliable(isReliable) {}
+
+std::string Packet::getHeaderName(Packet::Header header) {
+	switch (header) {
+		case Header::HANDSHAKE:       return "HANDSHAKE";
+		case Header::NICK_TAKEN:      return "NICK_TAKEN";
+		case Header::JOIN:            return "JOIN";
+		case Header::LEAVE:           return "LEAVE";
+		case Header::LOGIN:           return "LOGIN";
+		case Header::KICK:            return "KICK";
+		case Header::DISOWN:          return "DISOWN";
+		case Header::DESELECT:        return "DESELECT";
+		case Header::SPECTATE:        return "SPECTATE";
+		case Header::SUBSCRIBE:       return "SUBSCRIBE";
+		case Header::CREATE:          return "CREATE";
+		case Header::SELECT:          return "SELECT";
+		case Header::REMOVE:          return "REMOVE";
+		case Header::MOVE:            return "MOVE";
+		case Header::FLIP:            return "FLIP";
+		case Header::OWN:             return "OWN";
+		case Header::SHUFFLE:         return "SHUFFLE";
+		case Header::ROTATE:          return "ROTATE";
+		case Header::ORDER:           return "ORDER";
+		case Header::SCALE:           return "SCALE";
+		case Header::CHAT:            return "CHAT";
+		case Header::CHAT_PRIVATE:    return "CHAT_PRIVATE";
+		case Header::ROLL:            return "ROLL";
+		case Header::STAMP:           return "STAMP";
+		case Header::PACKAGE_MISSING: return "PACKAGE_MISSING";
+		case Header::FILE_TRANSFER:   return "FILE_TRANSFER";
+		case Header::MS_QUERY:        return "MS_QUERY";
+		case Header::MS_REGISTER:     return "MS_REGISTER";
+		case Header::MS_UPDATE:       return "MS_UPDATE";
+		case Header::PINGS:           return "PINGS";
+		case Header::TIME:            return "TIME";
+		default:                      return "UNKNOWN";
+	}
+}
+
 void Packet::setReliable(bool isReliable) {
 	this->isReliable = isReliable;
 }
@@ -98,6 +153,12 @@ void Packet::writeVector2(Vector2 value) {
 	this->writeFloat(value.y);
 }
 
+// Times are sent as whole seconds and microseconds
+void Packet::writeTime(double value) {
+	this->writeInt(static_cast<unsigned int>(value));
+	this->writeInt(static_cast<unsigned int>((value - std::floor(value)) * 1000000.0));
+}
+
 Packet::Header Packet::readHeader() {
 	return static_cast<Packet::Header>(this->readByte());
 }
@@ -161,6 +222,13 @@ Vector2 Packet::readVector2() {
 	return Vector2(this->readFloat(), this->readFloat());
 }
 
+double Packet::readTime() {
+	const unsigned int seconds = this->readInt();
+	const unsigned int microseconds = this->readInt();
+
+	return seconds + microseconds / 1000000.0;
+}
+
 unsigned int Packet::remainingBytes() const {
 	return this->data.length() - this->readCursor;
 }
@@ -169,14 +237,23 @@ bool Packet::eof() const {
 	return this->remainingBytes() == 0;
 }
 
-void Packet::send(){
+ENetPacket* Packet::createENetPacket() const {
 	int flags = 0;
 
 	if (this->isReliable) {
 		flags |= ENET_PACKET_FLAG_RELIABLE;
 	}
 
-	ENetPacket *packet = enet_packet_create(this->data.data(), this->data.length(), flags);
+	return enet_packet_create(this->data.data(), this->data.length(), flags);
+}
+
+void Packet::send(){
+	if (this->group != nullptr) {
+		this->group->send(this->data.data(), this->data.length(), this->isReliable);
+		return;
+	}
+
+	ENetPacket *packet = this->createENetPacket();
 
 	if (this->connection != nullptr) {
 		enet_host_broadcast(this->connection, 0, packet);
@@ -25,6 +25,7 @@
 #include <enet/enet.h>
 
 #include "vector2.h"
+#include "broadcastGroup.h"
 
 class PacketException : public std::runtime_error {
 public:
@@ -44,6 +45,8 @@ public:
 		KICK       = 0x06, // Kick a client
 		DISOWN     = 0x07, // Free all objects owned by a player
 		DESELECT   = 0x08, // Deselect objects that are selected by a player
+		SPECTATE   = 0x09, // Initialize connection as a spectator
+		SUBSCRIBE  = 0x0A, // Initialize connection as a relay server
 
 		// Object commands
 		CREATE  = 0x20, // Create new objects
@@ -61,6 +64,7 @@ public:
 		CHAT         = 0x40, // Send a chat message
 		CHAT_PRIVATE = 0x41, // Send a chat message to a specific client
 		ROLL         = 0x42, // Roll a die on the server
+		STAMP        = 0x43, // Measure the latency of the previous command
 
 		// Files and packages
 		PACKAGE_MISSING = 0x60, // Package not found
@@ -72,18 +76,27 @@ public:
 		MS_UPDATE   = 0xC2, // Update registered information
 
 		// Streamed packets
-		PINGS = 0xE0 // Broadcast ping information
+		PINGS = 0xE0, // Broadcast ping information
+		TIME  = 0xE1  // Broadcast the server clock
 	};
 
+	static std::string getHeaderName(Header header);
+
 	// Broadcast
 	Packet(ENetHost *connection, bool isReliable = true);
 
 	// Unicast
 	Packet(ENetPeer *peer, bool isReliable = true);
 
+	// Multicast to a group of peers
+	Packet(BroadcastGroup *group, bool isReliable = true);
+
 	// Received packet
 	Packet(ENetPacket *packet);
 
+	// Without a destination, sent through createENetPacket
+	Packet(bool isReliable = true);
+
 	void setReliable(bool isReliable);
 
 	void writeHeader(Header value);
@@ -93,6 +106,7 @@ public:
 	void writeString(std::string value);
 	void writeFloat(float value);
 	void writeVector2(Vector2 value);
+	void writeTime(double value);
 
 	Header readHeader(void);
 	unsigned char readByte(void);
@@ -101,10 +115,13 @@ public:
 	std::string readString(void);
 	float readFloat(void);
 	Vector2 readVector2(void);
+	double readTime(void);
 
 	unsigned int remainingBytes(void) const;
 	bool eof(void) const;
 
+	// Create an ENet packet of the data, e.g. for sending it several times
+	ENetPacket* createENetPacket(void) const;
 	void send(void);
 
 private:
@@ -113,6 +130,7 @@ private:
 
 	ENetHost *connection;
 	ENetPeer *peer;
+	BroadcastGroup *group;
 	bool isReliable;
 };
 
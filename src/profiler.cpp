@@ -0,0 +1,132 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "profiler.h"
+
+Profiler::Profiler(std::vector<std::string> sections, size_t historySize)
+: sections(sections),
+  histograms(sections.size()),
+  currentFrame(sections.size(), 0.0),
+  history(historySize, std::vector<double>(sections.size(), 0.0)),
+  historySize(historySize),
+  historyStart(0),
+  historyCount(0),
+  frameNumber(0) {
+
+}
+
+void Profiler::add(unsigned int section, double milliseconds) {
+	this->currentFrame[section] += milliseconds;
+}
+
+void Profiler::endFrame() {
+	for (unsigned int section = 0; section < this->sections.size(); ++section) {
+		this->histograms[section].add(this->currentFrame[section]);
+	}
+
+	if (this->historySize > 0) {
+		// Overwrite the oldest frame when the history is full
+		const size_t index = (this->historyStart + this->historyCount) % this->historySize;
+		this->history[index].swap(this->currentFrame);
+
+		if (this->historyCount < this->historySize) {
+			++this->historyCount;
+		} else {
+			this->historyStart = (this->historyStart + 1) % this->historySize;
+		}
+	}
+
+	this->currentFrame.assign(this->sections.size(), 0.0);
+	++this->frameNumber;
+}
+
+void Profiler::clear() {
+	for (auto &histogram : this->histograms) {
+		histogram.clear();
+	}
+
+	this->currentFrame.assign(this->sections.size(), 0.0);
+	this->historyStart = 0;
+	this->historyCount = 0;
+	this->frameNumber = 0;
+}
+
+size_t Profiler::getSectionCount() const {
+	return this->sections.size();
+}
+
+std::string Profiler::getSectionName(unsigned int section) const {
+	return this->sections.at(section);
+}
+
+const Histogram& Profiler::getHistogram(unsigned int section) const {
+	return this->histograms.at(section);
+}
+
+size_t Profiler::getHistorySize() const {
+	return this->historyCount;
+}
+
+// The age of the latest frame is 0
+double Profiler::getFrameTime(unsigned int section, size_t age) const {
+	const size_t index = (this->historyStart + this->historyCount - 1 - age) % this->historySize;
+
+	return this->history[index][section];
+}
+
+// Write the frames in the history with one column for each section
+bool Profiler::writeCsv(std::string path) const {
+	std::ofstream file(path.c_str());
+
+	if (! file.is_open()) {
+		return false;
+	}
+
+	file << "frame";
+	for (auto &section : this->sections) {
+		file << "," << section;
+	}
+	file << std::endl;
+
+	for (size_t age = this->historyCount; age > 0; --age) {
+		file << this->frameNumber - age;
+
+		for (unsigned int section = 0; section < this->sections.size(); ++section) {
+			file << "," << this->getFrameTime(section, age - 1);
+		}
+
+		file << std::endl;
+	}
+
+	return file.good();
+}
+
+ProfilerTimer::ProfilerTimer(Profiler *profiler, unsigned int section)
+: profiler(profiler),
+  section(section),
+  startTime(utils::getTime()) {
+
+}
+
+ProfilerTimer::~ProfilerTimer() {
+	const double duration = utils::getTime() - this->startTime;
+	this->profiler->add(this->section, duration * 1000.0);
+
+	if (trace::isEnabled()) {
+		trace::complete(this->profiler->getSectionName(this->section), "frame", this->startTime, duration);
+	}
+}
@@ -0,0 +1,75 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "utils.h"
+#include "histogram.h"
+#include "trace.h"
+
+// Collects the time spent in named sections of the main loop frame by
+// frame. The durations of the latest frames are kept for drawing graphs,
+// and every frame is added to the histogram of its section.
+class Profiler {
+public:
+	Profiler(std::vector<std::string> sections, size_t historySize);
+
+	void add(unsigned int section, double milliseconds);
+	void endFrame(void);
+	void clear(void);
+
+	size_t getSectionCount(void) const;
+	std::string getSectionName(unsigned int section) const;
+	const Histogram& getHistogram(unsigned int section) const;
+
+	size_t getHistorySize(void) const;
+	double getFrameTime(unsigned int section, size_t age) const;
+
+	bool writeCsv(std::string path) const;
+
+private:
+	std::vector<std::string> sections;
+	std::vector<Histogram> histograms;
+	std::vector<double> currentFrame;
+
+	// Ring buffer of the section durations of the latest frames
+	std::vector<std::vector<double>> history;
+	size_t historySize;
+	size_t historyStart;
+	size_t historyCount;
+	unsigned long long frameNumber;
+};
+
+// Adds the time from its construction to its destruction to a section,
+// and to the trace as a frame phase when tracing
+class ProfilerTimer {
+public:
+	ProfilerTimer(Profiler *profiler, unsigned int section);
+	~ProfilerTimer(void);
+
+private:
+	Profiler *profiler;
+	unsigned int section;
+	double startTime;
+};
+
+#endif
@@ -28,6 +28,18 @@ int main(int argc, char **argv) {
 		port = 0;
 	}
 
+	// Relay the game of an upstream server if one is given
+	std::string upstream;
+	unsigned int upstreamPort = 0;
+	if (argc >= 3) {
+		upstream = std::string(argv[2]);
+	}
+
+	if (argc >= 4) {
+		std::istringstream portString(argv[3]);
+		portString >> upstreamPort;
+	}
+
 	// Unix-like systems such as Linux _need_ to pass argv[0] from main() in here.
 	if (PHYSFS_init(argv[0]) == 0) {
 		std::cout << "Failed to initialize physfs" << std::endl;
@@ -37,7 +49,7 @@ int main(int argc, char **argv) {
 	PHYSFS_setWriteDir("data/");
 	PHYSFS_addToSearchPath(".", 1);
 
-	Server server = Server(port);
+	Server server = Server(port, upstream, upstreamPort);
 	Server::serverPtr = &server;
 
 	return server.run();
@@ -51,7 +63,15 @@ void Server::catchSignal(int signal) {
 	Server::serverPtr->exit();
 }
 
-Server::Server(unsigned int port) {
+Server::Server(unsigned int port, std::string upstream, unsigned int upstreamPort)
+: upstream(upstream),
+  upstreamPort(upstreamPort),
+  relay(nullptr),
+  masterServerConnection(nullptr),
+  masterServer(nullptr),
+  masterServerRegistered(false),
+  masterServerOutdated(false),
+  lastMasterServerUpdate(0) {
 	this->address.host = ENET_HOST_ANY;
 	this->address.port = port;
 
@@ -61,9 +81,13 @@ Server::Server(unsigned int port) {
 	this->lastStreamTime = 0.0;
 
 	this->randomGenerator.seed(enet_time_get());
+
+	this->playerGroup.setNext(&this->relayGroup);
+	this->relayGroup.setNext(&this->spectatorGroup);
 }
 
 Server::~Server() {
+	delete this->relay;
 	delete this->settings;
 }
 
@@ -82,7 +106,12 @@ int Server::run() {
 		return EXIT_FAILURE;
 	}
 
-	this->connection = enet_host_create(&this->address, net::MAX_CLIENTS, net::CHANNELS, 0, 0);
+	this->maxPlayers = std::min(static_cast<unsigned int>(this->settings->getValue<int>("network.maxplayers")), net::MAX_PLAYERS);
+	this->maxSpectators = this->settings->getValue<int>("network.maxspectators");
+	this->maxRelays = this->settings->getValue<int>("network.maxrelays");
+
+	// The relays have peer slots of their own
+	this->connection = enet_host_create(&this->address, this->maxPlayers + this->maxSpectators + this->maxRelays, net::CHANNELS, 0, 0);
 
 	if (this->connection == nullptr) {
 		std::cerr << "Could not bind to " << net::AddressToString(this->address) << "!" << std::endl;
@@ -91,21 +120,58 @@ int Server::run() {
 
 	std::cout << "Server listening on " << net::AddressToString(this->address) << "." << std::endl;
 
+	// The server clock is the reference of the trace timestamps
+	const std::string traceFile = this->settings->getValue<std::string>("trace.file");
+	if (! traceFile.empty() && ! trace::open(traceFile, 0, this->upstream.empty() ? "server" : "relay")) {
+		std::cerr << "Could not open the trace file " << traceFile << "!" << std::endl;
+	}
+
+	if (! this->upstream.empty()) {
+		if (this->upstreamPort == 0) {
+			this->upstreamPort = this->settings->getValue<int>("network.port");
+		}
+
+		this->relay = new Relay(this->upstream, this->upstreamPort, &this->spectatorGroup);
+
+		if (! this->relay->connect("relay " + net::AddressToString(this->address),
+		                           this->settings->getValue<std::string>("network.relaypassword"))) {
+			return EXIT_FAILURE;
+		}
+	} else if (this->settings->getValue<bool>("network.registerserver")) {
+		this->connectMasterServer();
+	}
+
 	// Enter the main loop
 	this->mainLoop();
 
 	// Disconnect all remaining clients
 	for (auto &client : this->clients) {
 		enet_peer_disconnect_now(client.second->getPeer(), 0);
-		delete static_cast<unsigned char*>(client.second->getPeer()->data);
 		delete client.second;
 	}
 
+	for (auto &spectator : this->spectators) {
+		enet_peer_disconnect_now(spectator.second->getPeer(), 0);
+		delete spectator.second;
+	}
+
 	// Dispose all objects
 	for (auto &object : this->objects) {
 		delete object.second;
 	}
 
+	if (this->relay != nullptr) {
+		this->relay->disconnect();
+	}
+
+	if (this->masterServerConnection != nullptr) {
+		if (this->masterServer != nullptr) {
+			enet_peer_disconnect_now(this->masterServer, 0);
+		}
+
+		enet_host_destroy(this->masterServerConnection);
+	}
+
 	// Exit the server
 	this->dispose();
 	return EXIT_SUCCESS;
@@ -113,9 +179,15 @@ int Server::run() {
 
 void Server::mainLoop() {
 	while (! this->exiting) {
+		if (this->relay != nullptr && ! this->relay->networkEvents()) {
+			break;
+		}
+
 		this->networkEvents();
+		this->masterServerEvents();
 
 		this->sendStream();
+		this->sendFileTransfers();
 	}
 }
 
@@ -126,22 +198,29 @@ void Server::exit() {
 void Server::dispose() {
 	enet_host_destroy(this->connection);
 	enet_deinitialize();
+
+	trace::close();
 }
 
 void Server::networkEvents() {
 	ENetEvent event;
 
-	// Wait up to 100 milliseconds for an event.
-	while (enet_host_service(this->connection, &event, 100) > 0) {
+	// Wait up to 100 milliseconds for an event. A relay waits for the upstream server instead,
+	// and the file transfers continue after a millisecond.
+	enet_uint32 timeout = 100;
+	if (this->relay != nullptr) {
+		timeout = 0;
+	} else if (! this->fileTransfers.empty()) {
+		timeout = 1;
+	}
+
+	while (enet_host_service(this->connection, &event, timeout) > 0) {
 		switch (event.type) {
 			case ENET_EVENT_TYPE_CONNECT: {
 				std::cout << "A new client connected from " << net::AddressToString(event.peer->address) << "." << std::endl;
 
-				unsigned char *id = new unsigned char;
-				*id = utils::firstUnusedKey(this->clients);
-				ServerClient *client = new ServerClient(event.peer, *id);
-				this->clients[*id] = client;
-				event.peer->data = id;
+				// The client gets an id when it joins as a player or a spectator
+				event.peer->data = nullptr;
 
 				// Set ping interval for the connection, this is only supported in ENet >= 1.3.4
 				#if ENET_VERSION >= ENET_VERSION_CREATE(1, 3, 4)
@@ -152,15 +231,38 @@ void Server::networkEvents() {
 			}
 
 			case ENET_EVENT_TYPE_RECEIVE: {
-				unsigned char *id = static_cast<unsigned char*>(event.peer->data);
+				ServerClient *client = static_cast<ServerClient*>(event.peer->data);
+
+				if (event.packet->dataLength == 0) {
+					// Ignore empty packets
+				} else if (client != nullptr || event.packet->data[0] == net::PACKET_HANDSHAKE
+				           || event.packet->data[0] == static_cast<unsigned char>(Packet::Header::SPECTATE)
+				           || event.packet->data[0] == static_cast<unsigned char>(Packet::Header::SUBSCRIBE)) {
+					// The latency stamps refer to the command received before them
+					if (client != nullptr && event.packet->data[0] != static_cast<unsigned char>(Packet::Header::STAMP)) {
+						client->setReceiveTime(trace::getServerTime());
+					}
+
+					trace::Scope scope([&] { return "receive " + Packet::getHeaderName(static_cast<Packet::Header>(event.packet->data[0])); }, "network");
+					scope.setArgument("client", Client::getIdStatic(client));
+					scope.setArgument("bytes", event.packet->dataLength);
 
-				if (this->clients[*id]->isJoined() || event.packet->data[0] == net::PACKET_HANDSHAKE) {
 					this->receivePacket(event);
 				} else if (event.packet->data[0] == net::PACKET_MS_QUERY) {
-					// This is not a master server
-					enet_peer_disconnect_now(event.peer, 0);
+					// Serve as a master server with only the local server on the list,
+					// the server browsers use this for probing.
+					Packet reply(event.peer);
+					reply.writeHeader(Packet::Header::MS_QUERY);
+					reply.writeShort(1);
+					reply.writeShort(0);
+					reply.writeString(""); // The public address is only known by the client
+					reply.writeShort(this->address.port);
+					reply.writeString(this->settings->getValue<std::string>("network.name"));
+					reply.writeShort(this->clients.size());
+					reply.writeShort(this->maxPlayers);
+					reply.send();
 
-					// TODO: Serve as a master server with only the local server on the list
+					enet_peer_disconnect_later(event.peer, 0);
 				}
 
 				enet_packet_destroy(event.packet);
@@ -169,37 +271,56 @@ void Server::networkEvents() {
 			}
 
 			case ENET_EVENT_TYPE_DISCONNECT: {
-				unsigned char *id = static_cast<unsigned char*>(event.peer->data);
+				ServerClient *client = static_cast<ServerClient*>(event.peer->data);
+
+				for (std::list<FileTransfer>::iterator transfer = this->fileTransfers.begin(); transfer != this->fileTransfers.end();) {
+					if (transfer->peer == event.peer) {
+						transfer = this->fileTransfers.erase(transfer);
+					} else {
+						++transfer;
+					}
+				}
 
-				if (this->clients[*id]->isJoined()) {
-					std::cout << this->clients[*id]->getNick() << " has left the server!" << std::endl;
+				if (client == nullptr) {
+					break;
+				}
+
+				if (client->isSpectator()) {
+					std::cout << client->getNick() << " stopped spectating." << std::endl;
+
+					this->relayGroup.remove(event.peer);
+					this->spectatorGroup.remove(event.peer);
+					this->spectators.erase(client->getId());
+				} else {
+					std::cout << client->getNick() << " has left the server!" << std::endl;
+
+					this->playerGroup.remove(event.peer);
+					this->clients.erase(client->getId());
+					this->masterServerOutdated = true;
 
 					// Broadcast the received event
-					char data[2];
-					data[0] = net::PACKET_LEAVE;
-					data[1] = *id;
+					std::string data;
+					data += net::PACKET_LEAVE;
+					data += static_cast<char>(client->getId());
 
-					net::sendCommand(this->connection, data, 2);
+					this->broadcast(data);
 
 					// Release selected and owned objects
 					for (auto &object : this->objects) {
-						if (object.second->isSelectedBy(this->clients[*id])) {
+						if (object.second->isSelectedBy(client)) {
 							object.second->select(nullptr);
 						}
 
-						if (object.second->isOwnedBy(this->clients[*id])) {
+						if (object.second->isOwnedBy(client)) {
 							object.second->setOwner(nullptr);
 						}
 					}
-
-					// Reset the peer's client information.
-					delete this->clients.find(*id)->second;
-					this->clients.erase(*id);
-
-					delete static_cast<unsigned char*>(event.peer->data);
-					event.peer->data = nullptr;
 				}
 
+				// Reset the peer's client information.
+				delete client;
+				event.peer->data = nullptr;
+
 				break;
 			}
 
@@ -215,89 +336,125 @@ void Server::receivePacket(ENetEvent event) {
 	Packet::Header header = packet.readHeader();
 
 	try {
-		unsigned char *id = static_cast<unsigned char*>(event.peer->data);
-		ServerClient *sender = this->clients[*id];
+		ServerClient *sender = static_cast<ServerClient*>(event.peer->data);
+		// The commands carry the id of a player in a byte, the spectators can only chat
+		unsigned char id = net::NO_CLIENT;
+		if (sender != nullptr && ! sender->isSpectator()) {
+			id = static_cast<unsigned char>(sender->getId());
+		}
+
+		if (sender != nullptr && sender->isSpectator() && header != Packet::Header::CHAT
+		    && header != Packet::Header::PACKAGE_MISSING) {
+			throw PacketException("Spectators can't issue commands.");
+		}
 
 		switch (header) {
 			case Packet::Header::HANDSHAKE: {
-				if (event.packet->dataLength >= 2 && event.packet->dataLength <= 17) {
+				if (sender == nullptr && event.packet->dataLength >= 2 && event.packet->dataLength <= 17) {
 					std::string nick = std::string(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
-					if (! net::isNickTaken(this->clients, nick)) {
-						this->clients[*id]->join();
-						this->clients[*id]->setNick(nick);
-
-						std::cout << this->clients[*id]->getNick() << " has joined the server!" << std::endl;
+					if (this->relay != nullptr) {
+						std::string data;
+						data += net::PACKET_CHAT;
+						data += net::NO_CLIENT;
+						data += "This server relays a game, you can only join as a spectator.";
 
-						// Reply to the joining client with his ID and the list of clients
-						{
-							std::string data;
-							data += net::PACKET_HANDSHAKE;
-							data += *id;
-
-							for (std::map<unsigned char, ServerClient*>::iterator client = this->clients.begin(); client != this->clients.end(); ++client) {
-								if (client->second->isJoined() && client->first != *id)
-								{
-									data += client->first;
-									data += static_cast<char>(client->second->getNick().length());
-									data += client->second->getNick();
-								}
-							}
+						net::sendCommand(event.peer, data.c_str(), data.length());
+						enet_peer_disconnect_later(event.peer, 0);
+					} else if (net::isNickTaken(this->clients, nick)) {
+						// Reply that the nick is taken
+						char data[1];
+						data[0] = net::PACKET_NICK_TAKEN;
 
-							net::sendCommand(event.peer, data.c_str(), data.length());
-						}
+						net::sendCommand(event.peer, data, 1);
+					} else if (this->clients.size() >= this->maxPlayers) {
+						std::string data;
+						data += net::PACKET_CHAT;
+						data += net::NO_CLIENT;
+						data += "The server is full, but you can still join as a spectator.";
 
-						// Send the list of objects
-						{
-							std::string data;
-							data += net::PACKET_CREATE;
-							data += 255; // The objects are now new
-
-							for (auto &object : this->objects) {
-								net::dataAppendShort(data, object.second->getId());
-								data += Client::getIdStatic(object.second->getSelected());
-								data += Client::getIdStatic(object.second->getOwner());
-								data += object.second->isFlipped();
-								net::dataAppendVector2(data, object.second->getLocation());
-								data.push_back(floor(object.second->getRotation() / (utils::PI / 8.0f) + 0.5f));
-								data.push_back(static_cast<char>(object.second->getFullId().size()));
-								data.append(object.second->getFullId());
-							}
+						net::sendCommand(event.peer, data.c_str(), data.length());
+						enet_peer_disconnect_later(event.peer, 0);
+					} else {
+						id = utils::firstUnusedKey(this->clients);
+						sender = new ServerClient(event.peer, id);
+						sender->join();
+						sender->setNick(nick);
+						this->clients[id] = sender;
+						event.peer->data = sender;
 
-							net::sendCommand(event.peer, data.c_str(), data.length());
-						}
+						std::cout << sender->getNick() << " has joined the server!" << std::endl;
 
-						// Send object order
-						{
-							if (!this->objects.empty()) {
-								Packet reply(this->connection);
-								reply.writeHeader(Packet::Header::ORDER);
-								for (auto &object : this->objectOrder) {
-									reply.writeShort(object->getId());
-								}
-								reply.send();
-							}
-						}
+						this->sendGameState(event.peer, id);
+						this->playerGroup.add(event.peer);
+						this->masterServerOutdated = true;
 
 						// Broadcast a join event
 						{
 							std::string data;
 							data += net::PACKET_JOIN;
-							data += *id;
+							data += id;
 							data += nick;
 
-							net::sendCommand(connection, data.c_str(), data.length());
+							this->broadcast(data);
 						}
 
 						// Rush stream information
 						this->lastStreamTime = 0.0;
+					}
+				}
+
+				break;
+			}
+
+			case Packet::Header::SPECTATE: {
+				if (sender == nullptr && event.packet->dataLength >= 2 && event.packet->dataLength <= 17) {
+					// The relays are kept with the spectators, but they don't count towards the limit
+					if (this->spectators.size() - this->relayGroup.size() >= this->maxSpectators
+					    || (this->relay != nullptr && ! this->relay->isSubscribed())) {
+						enet_peer_disconnect(event.peer, 0);
+						break;
+					}
+
+					sender = this->addSpectator(event.peer, std::string(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1));
+
+					std::cout << sender->getNick() << " is spectating." << std::endl;
+
+					if (this->relay != nullptr) {
+						this->relay->sendGameState(event.peer);
 					} else {
-						// Reply that the nick is taken
-						char data[1];
-						data[0] = net::PACKET_NICK_TAKEN;
+						this->sendGameState(event.peer, net::NO_CLIENT);
+					}
 
-						net::sendCommand(event.peer, data, 1);
+					this->spectatorGroup.add(event.peer);
+
+					// Rush stream information
+					this->lastStreamTime = 0.0;
+				}
+
+				break;
+			}
+
+			case Packet::Header::SUBSCRIBE: {
+				if (sender == nullptr) {
+					std::string name = packet.readString();
+
+					if (this->relay != nullptr || ! this->settings->getValue<bool>("network.allowrelays")
+					    || this->relayGroup.size() >= this->maxRelays
+					    || packet.readString() != this->settings->getValue<std::string>("network.relaypassword")) {
+						std::cout << "Refused a relay from " << net::AddressToString(event.peer->address) << "." << std::endl;
+
+						enet_peer_disconnect(event.peer, 0);
+						break;
 					}
+
+					// Relays don't count towards the spectator limit
+					sender = this->addSpectator(event.peer, name);
+
+					std::cout << sender->getNick() << " subscribed from " << net::AddressToString(event.peer->address) << "." << std::endl;
+
+					this->sendGameState(event.peer, net::NO_CLIENT);
+					this->relayGroup.add(event.peer);
 				}
 
 				break;
@@ -330,14 +487,27 @@ void Server::receivePacket(ENetEvent event) {
 			}
 
 			case Packet::Header::CHAT: {
-				if (event.packet->dataLength >= 1 + 1 && event.packet->dataLength <= 1 + 1 + 255) {
+				if (sender->isSpectator()) {
+					// Spectators only talk to each other
+					if (event.packet->dataLength >= 1 + 1 && event.packet->dataLength <= 1 + 255) {
+						std::string message = "^888" + sender->getNick() + ": "
+						                      + std::string(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
+
+						std::string data;
+						data += net::PACKET_CHAT;
+						data += net::NO_CLIENT;
+						data.append(message, 0, 255);
+
+						this->spectatorGroup.send(data.c_str(), data.length());
+					}
+				} else if (event.packet->dataLength >= 1 + 1 && event.packet->dataLength <= 1 + 1 + 255) {
 					std::string data;
 					data += net::PACKET_CHAT;
-					data += *id;
+					data += id;
 					data.append(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
-					std::cout << this->clients[*id]->getNick() << ": " << std::string(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1) << std::endl;
-					net::sendCommand(this->connection, data.c_str(), event.packet->dataLength + 1);
+					std::cout << sender->getNick() << ": " << std::string(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1) << std::endl;
+					this->broadcast(data);
 				}
 
 				break;
@@ -354,7 +524,7 @@ void Server::receivePacket(ENetEvent event) {
 					std::uniform_int_distribution<unsigned short> distribution(1, maxValue);
 
 					std::ostringstream reply;
-					reply << this->clients[*id]->getColoredNick() << " rolled a " << "d" << maxValue << " and got " << distribution(this->randomGenerator) << ".";
+					reply << sender->getColoredNick() << " rolled a " << "d" << maxValue << " and got " << distribution(this->randomGenerator) << ".";
 
 					std::string data;
 					data += net::PACKET_CHAT;
@@ -362,18 +532,32 @@ void Server::receivePacket(ENetEvent event) {
 					data.append(reply.str());
 
 					std::cout << reply.str() << std::endl;
-					net::sendCommand(this->connection, data.c_str(), 2 + reply.str().length());
+					this->broadcast(data);
 				}
 
 				break;
 			}
 
+			case Packet::Header::STAMP: {
+				// Echo the stamp to everybody with the time the previous command
+				// of the client arrived and the time it was passed on
+				Packet reply(&this->playerGroup);
+				reply.writeHeader(Packet::Header::STAMP);
+				reply.writeByte(id);
+				reply.writeShort(packet.readShort());
+				reply.writeTime(sender->getReceiveTime());
+				reply.writeTime(sender->getBroadcastTime());
+				reply.send();
+
+				break;
+			}
+
 			case Packet::Header::CREATE: {
 				unsigned int i = 0;
 				unsigned int amount = 0;
 				std::string data;
 				data.push_back(net::PACKET_CREATE);
-				data += *id;
+				data += id;
 
 				if (event.packet->dataLength >= 1 + 9 + 1) {
 					while (i < event.packet->dataLength - 1) {
@@ -425,10 +609,10 @@ void Server::receivePacket(ENetEvent event) {
 						i += length + 13;
 					}
 
-					std::cout << this->clients[*id]->getNick() << " created " << amount << " objects." << std::endl;
+					std::cout << sender->getNick() << " created " << amount << " objects." << std::endl;
 				}
 
-				net::sendCommand(this->connection, data.c_str(), data.size());
+				this->broadcast(data);
 				break;
 			}
 
@@ -437,10 +621,10 @@ void Server::receivePacket(ENetEvent event) {
 					if (this->objects.count(event.packet->data[1]) > 0) {
 						std::string data;
 						data += net::PACKET_MOVE;
-						data += *id;
+						data += id;
 						data.append(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
-						net::sendCommand(this->connection, data.c_str(), event.packet->dataLength + 1);
+						this->broadcast(data);
 
 						unsigned int numberObjects = 0;
 						Object *lastObject;
@@ -463,9 +647,9 @@ void Server::receivePacket(ENetEvent event) {
 						}
 
 						if (numberObjects == 1) {
-							std::cout << this->clients[*id]->getNick() << " moved " << lastObject->getName() << "." << std::endl;
+							std::cout << sender->getNick() << " moved " << lastObject->getName() << "." << std::endl;
 						} else if (numberObjects >= 2) {
-							std::cout << this->clients[*id]->getNick() << " moved " << numberObjects << " objects." << std::endl;
+							std::cout << sender->getNick() << " moved " << numberObjects << " objects." << std::endl;
 						}
 					}
 				}
@@ -478,11 +662,11 @@ void Server::receivePacket(ENetEvent event) {
 					std::string data;
 
 					data += net::PACKET_SELECT;
-					data += *id;
+					data += id;
 					data.append(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
 					for (auto &object : this->objects) {
-						if (object.second->isSelectedBy(this->clients.find(*id)->second)) {
+						if (object.second->isSelectedBy(sender)) {
 							object.second->select(nullptr);
 						}
 					}
@@ -492,12 +676,12 @@ void Server::receivePacket(ENetEvent event) {
 						unsigned short objId = net::bytesToShort(event.packet->data + i);
 
 						Object* object = this->objects.find(objId)->second;
-						object->select(this->clients[*id]);
+						object->select(sender);
 
 						i += 2;
 					}
 
-					net::sendCommand(this->connection, data.c_str(), event.packet->dataLength + 1);
+					this->broadcast(data);
 				}
 
 				break;
@@ -508,7 +692,7 @@ void Server::receivePacket(ENetEvent event) {
 					std::string data;
 
 					data += net::PACKET_REMOVE;
-					data += *id;
+					data += id;
 					data.append(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
 					unsigned int numberObjects = 0;
@@ -531,12 +715,12 @@ void Server::receivePacket(ENetEvent event) {
 					}
 
 					if (numberObjects == 1) {
-						std::cout << this->clients[*id]->getNick() << " removed " << lastObject << "." << std::endl;
+						std::cout << sender->getNick() << " removed " << lastObject << "." << std::endl;
 					} else if (numberObjects >= 2) {
-						std::cout << this->clients[*id]->getNick() << " removed " << utils::toString(numberObjects) << " objects." << std::endl;
+						std::cout << sender->getNick() << " removed " << utils::toString(numberObjects) << " objects." << std::endl;
 					}
 
-					net::sendCommand(this->connection, data.c_str(), event.packet->dataLength + 1);
+					this->broadcast(data);
 				}
 
 				break;
@@ -547,7 +731,7 @@ void Server::receivePacket(ENetEvent event) {
 					std::string data;
 
 					data += net::PACKET_FLIP;
-					data += *id;
+					data += id;
 					data.append(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
 					bool flipped = event.packet->data[1];
@@ -569,12 +753,12 @@ void Server::receivePacket(ENetEvent event) {
 					}
 
 					if (numberObjects == 1) {
-						std::cout << this->clients[*id]->getNick() << " flipped " << lastObject->getName() << "." << std::endl;
+						std::cout << sender->getNick() << " flipped " << lastObject->getName() << "." << std::endl;
 					} else if (numberObjects >= 2) {
-						std::cout << this->clients[*id]->getNick() << " flipped " << numberObjects << " objects." << std::endl;
+						std::cout << sender->getNick() << " flipped " << numberObjects << " objects." << std::endl;
 					}
 
-					net::sendCommand(this->connection, data.c_str(), event.packet->dataLength + 1);
+					this->broadcast(data);
 				}
 
 				break;
@@ -585,7 +769,7 @@ void Server::receivePacket(ENetEvent event) {
 					std::string data;
 
 					data += net::PACKET_OWN;
-					data += *id;
+					data += id;
 					data.append(reinterpret_cast<char*>(event.packet->data + 1), event.packet->dataLength - 1);
 
 					bool owned = event.packet->data[1];
@@ -601,7 +785,7 @@ void Server::receivePacket(ENetEvent event) {
 
 						Object* object = this->objects.find(objId)->second;
 						if (owned) {
-							object->setOwner(this->clients[*id]);
+							object->setOwner(sender);
 						} else {
 							object->setOwner(nullptr);
 						}
@@ -619,12 +803,12 @@ void Server::receivePacket(ENetEvent event) {
 					}
 
 					if (numberObjects == 1) {
-						std::cout << this->clients[*id]->getNick() << " " << verb << " " << lastObject->getName() << "." << std::endl;
+						std::cout << sender->getNick() << " " << verb << " " << lastObject->getName() << "." << std::endl;
 					} else if (numberObjects >= 2) {
-						std::cout << this->clients[*id]->getNick() << " " << verb << " " << numberObjects << " objects." << std::endl;
+						std::cout << sender->getNick() << " " << verb << " " << numberObjects << " objects." << std::endl;
 					}
 
-					net::sendCommand(this->connection, data.c_str(), event.packet->dataLength + 1);
+					this->broadcast(data);
 				}
 
 				break;
@@ -636,14 +820,14 @@ void Server::receivePacket(ENetEvent event) {
 					{
 						std::string data;
 						data += net::PACKET_MOVE;
-						data += *id;
+						data += id;
 
 						std::vector<Object*> objects;
 						std::vector<std::pair<int, Vector2>> locations;
 
 						// Get objects to suffle and order and locations of them
 						for (auto &object : this->objects) {
-							if (object.second->isSelectedBy(this->clients[*id])) {
+							if (object.second->isSelectedBy(sender)) {
 								objects.push_back(object.second);
 								int orderIndex = std::distance(this->objectOrder.begin(), std::find(this->objectOrder.begin(),
 																this->objectOrder.end(), object.second));
@@ -664,10 +848,10 @@ void Server::receivePacket(ENetEvent event) {
 							++location;
 						}
 
-						net::sendCommand(this->connection, data.c_str(), data.length());
+						this->broadcast(data);
 
 						// Send new obj order
-						Packet reply(this->connection);
+						Packet reply(&this->playerGroup);
 						reply.writeHeader(Packet::Header::ORDER);
 						for (auto &object : this->objectOrder) {
 							reply.writeShort(object->getId());
@@ -683,59 +867,24 @@ void Server::receivePacket(ENetEvent event) {
 				unsigned short objId = net::bytesToShort(event.packet->data + 1);
 				char rotation = event.packet->data[3];
 				this->objects[objId]->rotate(rotation * utils::PI / 8.0f);
-				net::sendCommand(this->connection, reinterpret_cast<char*>(event.packet->data), event.packet->dataLength);
+				this->broadcast(std::string(reinterpret_cast<char*>(event.packet->data), event.packet->dataLength));
 
 				break;
 			}
 
 			case Packet::Header::PACKAGE_MISSING: {
-				std::string package = packet.readString();
-				std::cout<< this->clients.find(*id)->second->getNick() << " is missing package "<<package<<std::endl;
-
-				if (PHYSFS_exists(("data/" + package + ".zip").c_str())) {
-					PHYSFS_file* file = PHYSFS_openRead(("data/" + package + ".zip").c_str());
-					Packet reply(event.peer);
-					reply.writeHeader(Packet::Header::FILE_TRANSFER);
-					reply.writeShort(0);
-					reply.writeInt(PHYSFS_fileLength(file));
-					reply.writeString(package);
-					reply.send();
-
-					char *buf;
-					buf = new char[PHYSFS_fileLength(file)];
-					PHYSFS_read(file, buf, 1, PHYSFS_fileLength(file));
-					int i = 0;
-					short number = 1;
-
-					const int packetSize = event.peer->mtu - 7 - 50;
-
-					while (i < PHYSFS_fileLength(file)) {
-						Packet piece(event.peer);
-						piece.writeHeader(Packet::Header::FILE_TRANSFER);
-						piece.writeShort(number);
-						piece.writeInt(i);
-						number++;
-
-						if (i + packetSize <= PHYSFS_fileLength(file)) {
-							piece.writeInt(packetSize);
-							piece.writeString(std::string(buf + i, packetSize));
-						} else {
-							piece.writeInt(PHYSFS_fileLength(file) - i);
-							piece.writeString(std::string(buf + i, PHYSFS_fileLength(file) - i));
-						}
+				while (! packet.eof()) {
+					std::string package = packet.readString();
+					std::cout<< sender->getNick() << " is missing package "<<package<<std::endl;
 
-						piece.send();
-						i += packetSize;
-					}
-
-					PHYSFS_close(file);
+					this->startFileTransfer(event.peer, package);
 				}
 
 				break;
 			}
 			case Packet::Header::SCALE: {
 				if (event.packet->dataLength >= 1) {
-					Packet reply(this->connection);
+					Packet reply(&this->playerGroup);
 					reply.writeHeader(Packet::Header::SCALE);
 					while(!packet.eof()) {
 						unsigned short id = packet.readShort();
@@ -753,6 +902,11 @@ void Server::receivePacket(ENetEvent event) {
 				throw PacketException("Invalid packet header.");
 			}
 		}
+
+		// The command has been passed on to the players, the latency stamps refer to it
+		if (sender != nullptr && header != Packet::Header::STAMP) {
+			sender->setBroadcastTime(trace::getServerTime());
+		}
 	} catch (PacketException &e) {
 		std::cout << "Debug: Received an invalid packet from "
 		          << net::AddressToString(event.peer->address)
@@ -760,6 +914,79 @@ void Server::receivePacket(ENetEvent event) {
 	}
 }
 
+// Send a command to the players first and then to the spectators
+void Server::broadcast(const std::string &data, bool isReliable) {
+	trace::Scope scope([&] { return "broadcast " + Packet::getHeaderName(static_cast<Packet::Header>(data.at(0))); }, "network");
+	scope.setArgument("bytes", data.length());
+
+	this->playerGroup.send(data.c_str(), data.length(), isReliable);
+}
+
+ServerClient* Server::addSpectator(ENetPeer *peer, std::string nick) {
+	unsigned short id = net::FIRST_SPECTATOR_ID;
+	while (this->spectators.count(id) != 0) {
+		++id;
+	}
+
+	ServerClient *spectator = new ServerClient(peer, id, true);
+	spectator->join();
+	spectator->setNick(nick);
+	this->spectators[id] = spectator;
+	peer->data = spectator;
+
+	return spectator;
+}
+
+// Send the list of players and the objects on the table to a joining client
+void Server::sendGameState(ENetPeer *peer, unsigned char id) {
+	// Reply to the joining client with his ID and the list of clients
+	{
+		std::string data;
+		data += net::PACKET_HANDSHAKE;
+		data += id;
+
+		for (auto &client : this->clients) {
+			if (client.first != id) {
+				data += client.first;
+				data += static_cast<char>(client.second->getNick().length());
+				data += client.second->getNick();
+			}
+		}
+
+		net::sendCommand(peer, data.c_str(), data.length());
+	}
+
+	// Send the list of objects
+	{
+		std::string data;
+		data += net::PACKET_CREATE;
+		data += 255; // The objects are now new
+
+		for (auto &object : this->objects) {
+			net::dataAppendShort(data, object.second->getId());
+			data += static_cast<unsigned char>(Client::getIdStatic(object.second->getSelected()));
+			data += static_cast<unsigned char>(Client::getIdStatic(object.second->getOwner()));
+			data += object.second->isFlipped();
+			net::dataAppendVector2(data, object.second->getLocation());
+			data.push_back(floor(object.second->getRotation() / (utils::PI / 8.0f) + 0.5f));
+			data.push_back(static_cast<char>(object.second->getFullId().size()));
+			data.append(object.second->getFullId());
+		}
+
+		net::sendCommand(peer, data.c_str(), data.length());
+	}
+
+	// Send object order
+	if (! this->objects.empty()) {
+		Packet reply(peer);
+		reply.writeHeader(Packet::Header::ORDER);
+		for (auto &object : this->objectOrder) {
+			reply.writeShort(object->getId());
+		}
+		reply.send();
+	}
+}
+
 void Server::sendStream() {
 	if (enet_time_get() > this->lastStreamTime + net::STREAM_INTERVAL) {
 		this->lastStreamTime = enet_time_get();
@@ -769,17 +996,242 @@ void Server::sendStream() {
 			std::string data;
 			data += net::PACKET_PINGS;
 
-			for (unsigned char id = 0; id < net::MAX_CLIENTS; ++id) {
-				if (this->clients.count(id) > 0 && this->clients[id]->isJoined()) {
-					data += id;
-					net::dataAppendShort(data, this->clients[id]->getPeer()->roundTripTime);
-				}
+			for (auto &client : this->clients) {
+				data += client.first;
+				net::dataAppendShort(data, client.second->getPeer()->roundTripTime);
 			}
 
 			// Only send stream data if there is at least one client
 			if (data.length() > 1) {
-				net::sendCommand(this->connection, data.c_str(), data.length(), false);
+				this->broadcast(data, false);
+			}
+		}
+
+		// Stream the clock for synchronizing the trace timestamps. A relay
+		// passes on the clock of the upstream server.
+		{
+			Packet packet(&this->playerGroup, false);
+			packet.writeHeader(Packet::Header::TIME);
+			packet.writeTime(trace::getServerTime());
+			packet.send();
+		}
+	}
+}
+
+// Send the header of the package now, the pieces follow in sendFileTransfers
+void Server::startFileTransfer(ENetPeer *peer, std::string package) {
+	PHYSFS_file* file = nullptr;
+	if (PHYSFS_exists(("data/" + package + ".zip").c_str())) {
+		file = PHYSFS_openRead(("data/" + package + ".zip").c_str());
+	}
+
+	const PHYSFS_sint64 length = file != nullptr ? PHYSFS_fileLength(file) : -1;
+	const size_t pieceSize = peer->mtu - 8 - 50;
+	const bool tooLarge = length >= 0 && (static_cast<size_t>(length) + pieceSize - 1) / pieceSize > MAX_FILE_PIECES;
+	const int id = this->getFreeTransferId(peer);
+
+	if (length < 0 || tooLarge || id < 0) {
+		if (tooLarge) {
+			std::cout << "The package " << package << " is too large to be sent." << std::endl;
+		}
+
+		if (file != nullptr) {
+			PHYSFS_close(file);
+		}
+
+		// Let the client know that it shouldn't wait for the package
+		Packet reply(peer);
+		reply.writeHeader(Packet::Header::PACKAGE_MISSING);
+		reply.writeString(package);
+		reply.send();
+
+		return;
+	}
+
+	FileTransfer transfer;
+	transfer.peer = peer;
+	transfer.id = static_cast<unsigned char>(id);
+	transfer.data.resize(length);
+	transfer.pieceSize = pieceSize;
+	transfer.offset = 0;
+	transfer.number = 1;
+
+	if (! transfer.data.empty()) {
+		PHYSFS_read(file, &transfer.data[0], 1, transfer.data.size());
+	}
+
+	PHYSFS_close(file);
+
+	Packet reply(peer);
+	reply.writeHeader(Packet::Header::FILE_TRANSFER);
+	reply.writeByte(transfer.id);
+	reply.writeShort(0);
+	reply.writeInt(transfer.data.size());
+	reply.writeString(package);
+	reply.send();
+
+	if (! transfer.data.empty()) {
+		this->fileTransfers.push_back(transfer);
+	}
+}
+
+// Queue a burst of pieces of every file transfer, a piece of each transfer at a time
+void Server::sendFileTransfers() {
+	for (unsigned int round = 0; round < FILE_TRANSFER_BURST && ! this->fileTransfers.empty(); ++round) {
+		for (std::list<FileTransfer>::iterator transfer = this->fileTransfers.begin(); transfer != this->fileTransfers.end();) {
+			const size_t packetSize = std::min(transfer->pieceSize, transfer->data.size() - transfer->offset);
+
+			Packet piece(transfer->peer);
+			piece.writeHeader(Packet::Header::FILE_TRANSFER);
+			piece.writeByte(transfer->id);
+			piece.writeShort(transfer->number);
+			piece.writeInt(transfer->offset);
+			piece.writeInt(packetSize);
+			piece.writeString(transfer->data.substr(transfer->offset, packetSize));
+
+			trace::Scope scope("send FILE_TRANSFER", "file");
+			scope.setArgument("transfer", transfer->id);
+			scope.setArgument("chunk", transfer->number);
+			scope.setArgument("offset", transfer->offset);
+
+			piece.send();
+
+			transfer->offset += packetSize;
+			++transfer->number;
+
+			if (transfer->offset >= transfer->data.size()) {
+				transfer = this->fileTransfers.erase(transfer);
+			} else {
+				++transfer;
 			}
 		}
 	}
 }
+
+// Get an id that none of the transfers of the peer uses, or -1 if all are taken
+int Server::getFreeTransferId(ENetPeer *peer) const {
+	std::vector<bool> used(256, false);
+
+	for (auto &transfer : this->fileTransfers) {
+		if (transfer.peer == peer) {
+			used.at(transfer.id) = true;
+		}
+	}
+
+	for (int id = 0; id < 256; ++id) {
+		if (! used.at(id)) {
+			return id;
+		}
+	}
+
+	return -1;
+}
+
+void Server::connectMasterServer() {
+	ENetAddress address;
+
+	if (enet_address_set_host(&address, this->settings->getValue<std::string>("network.masterserver").c_str()) < 0) {
+		std::cerr << "Unknown master server host!" << std::endl;
+		return;
+	}
+
+	address.port = this->settings->getValue<int>("network.masterserverport");
+
+	if (this->masterServerConnection == nullptr) {
+		this->masterServerConnection = enet_host_create(nullptr, 1, 1, 0, 0);
+
+		if (this->masterServerConnection == nullptr) {
+			std::cerr << "Could not create a connection to the master server!" << std::endl;
+			return;
+		}
+	}
+
+	this->masterServer = enet_host_connect(this->masterServerConnection, &address, 1, 0);
+	this->lastMasterServerUpdate = enet_time_get();
+}
+
+void Server::masterServerEvents() {
+	if (this->masterServerConnection == nullptr) {
+		return;
+	}
+
+	ENetEvent event;
+
+	while (enet_host_service(this->masterServerConnection, &event, 0) > 0) {
+		switch (event.type) {
+			case ENET_EVENT_TYPE_CONNECT: {
+				std::cout << "Registering to the master server " << net::AddressToString(event.peer->address) << "." << std::endl;
+
+				this->masterServerRegistered = true;
+				this->updateMasterServer(Packet::Header::MS_REGISTER);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_RECEIVE: {
+				enet_packet_destroy(event.packet);
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_DISCONNECT: {
+				if (this->masterServerRegistered) {
+					std::cout << "Lost the connection to the master server." << std::endl;
+				}
+
+				this->masterServer = nullptr;
+				this->masterServerRegistered = false;
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_NONE: {
+				break;
+			}
+		}
+	}
+
+	const enet_uint32 time = enet_time_get();
+
+	if (this->masterServer == nullptr) {
+		// Retry once in a heartbeat interval
+		if (time > this->lastMasterServerUpdate + net::MASTER_SERVER_HEARTBEAT_INTERVAL) {
+			this->connectMasterServer();
+		}
+	} else if (this->masterServerRegistered && (this->masterServerOutdated
+	           || time > this->lastMasterServerUpdate + net::MASTER_SERVER_HEARTBEAT_INTERVAL)) {
+		this->updateMasterServer(Packet::Header::MS_UPDATE);
+	}
+}
+
+// Send the server information, also works as a heartbeat
+void Server::updateMasterServer(Packet::Header header) {
+	Packet packet(this->masterServer);
+	packet.writeHeader(header);
+	packet.writeShort(this->address.port);
+	packet.writeString(this->settings->getValue<std::string>("network.name"));
+	packet.writeShort(this->clients.size());
+	packet.writeShort(this->maxPlayers);
+
+	// List the packages that the server can send to the clients
+	std::vector<std::string> packages;
+	char **files = PHYSFS_enumerateFiles("data");
+	for (char **file = files; *file != nullptr; ++file) {
+		const std::string name(*file);
+
+		if (name.length() > 4 && name.compare(name.length() - 4, 4, ".zip") == 0) {
+			packages.push_back(name.substr(0, name.length() - 4));
+		}
+	}
+	PHYSFS_freeList(files);
+
+	packet.writeShort(packages.size());
+	for (auto &package : packages) {
+		packet.writeString(package);
+	}
+
+	packet.send();
+
+	this->masterServerOutdated = false;
+	this->lastMasterServerUpdate = enet_time_get();
+}
@@ -22,6 +22,7 @@
 #include <cstdlib>
 #include <csignal>
 #include <map>
+#include <list>
 #include <string>
 #include <iostream>
 #include <algorithm>
@@ -37,14 +38,23 @@
 #include "../objectClassManager.h"
 #include "../object.h"
 #include "../settings.h"
+#include "../broadcastGroup.h"
+#include "../trace.h"
+#include "relay.h"
 
 class Server;
 
 int main(int argc, char **argv);
 
+// The pieces each file transfer sends in turn on every round
+const unsigned int FILE_TRANSFER_BURST = 16;
+
+// The pieces are numbered with a short from one, which limits the size of a package
+const size_t MAX_FILE_PIECES = 65535;
+
 class Server {
 public:
-	Server(unsigned int port);
+	Server(unsigned int port, std::string upstream = "", unsigned int upstreamPort = 0);
 	~Server(void);
 
 	static Server *serverPtr;
@@ -61,10 +71,46 @@ private:
 
 	ObjectClassManager objectClassManager;
 
+	unsigned int maxPlayers;
+	unsigned int maxSpectators;
+	unsigned int maxRelays;
+
 	std::map<unsigned char, ServerClient*> clients;
+	std::map<unsigned short, ServerClient*> spectators;
+
+	// The players get the broadcasts before the relays and the spectators
+	BroadcastGroup playerGroup;
+	BroadcastGroup relayGroup;
+	BroadcastGroup spectatorGroup;
+
+	// In relay mode the game is played on the upstream server
+	std::string upstream;
+	unsigned int upstreamPort;
+	Relay *relay;
+
+	// Registration to the server list
+	ENetHost *masterServerConnection;
+	ENetPeer *masterServer;
+	bool masterServerRegistered;
+	bool masterServerOutdated;
+	enet_uint32 lastMasterServerUpdate;
+
 	std::map<unsigned short, Object*> objects;
 	std::vector<Object*> objectOrder;
 
+	// A package being sent to a client in pieces. The transfers take turns,
+	// so that every package of a client downloads at the same time.
+	struct FileTransfer {
+		ENetPeer *peer;
+		unsigned char id; // Unique among the transfers of the peer
+		std::string data;
+		size_t pieceSize;
+		size_t offset;
+		unsigned short number;
+	};
+
+	std::list<FileTransfer> fileTransfers;
+
 	bool exiting;
 
 	double lastStreamTime;
@@ -76,7 +122,17 @@ private:
 
 	void networkEvents(void);
 	void receivePacket(ENetEvent event);
+	void broadcast(const std::string &data, bool isReliable = true);
+	void sendGameState(ENetPeer *peer, unsigned char id);
+	ServerClient* addSpectator(ENetPeer *peer, std::string nick);
 	void sendStream(void);
+	void startFileTransfer(ENetPeer *peer, std::string package);
+	int getFreeTransferId(ENetPeer *peer) const;
+	void sendFileTransfers(void);
+
+	void connectMasterServer(void);
+	void masterServerEvents(void);
+	void updateMasterServer(Packet::Header header);
 };
 
 #endif
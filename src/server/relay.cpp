@@ -0,0 +1,380 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "relay.h"
+
+Relay::Relay(std::string host, unsigned int port, BroadcastGroup *downstream)
+: host(host),
+  connection(nullptr),
+  peer(nullptr),
+  downstream(downstream),
+  subscribed(false) {
+	this->address.host = ENET_HOST_ANY;
+	this->address.port = port;
+}
+
+Relay::~Relay() {
+	if (this->connection != nullptr) {
+		enet_host_destroy(this->connection);
+	}
+}
+
+bool Relay::connect(std::string name, std::string password) {
+	this->name = name;
+	this->password = password;
+
+	if (enet_address_set_host(&this->address, this->host.c_str()) < 0) {
+		std::cerr << "Unknown upstream host " << this->host << "!" << std::endl;
+		return false;
+	}
+
+	this->connection = enet_host_create(nullptr, 1, net::CHANNELS, 0, 0);
+
+	if (this->connection == nullptr) {
+		std::cerr << "Could not create the upstream connection!" << std::endl;
+		return false;
+	}
+
+	this->peer = enet_host_connect(this->connection, &this->address, net::CHANNELS, 0);
+
+	if (this->peer == nullptr) {
+		std::cerr << "Could not connect to " << net::AddressToString(this->address) << "!" << std::endl;
+		return false;
+	}
+
+	std::cout << "Relaying " << net::AddressToString(this->address) << "." << std::endl;
+
+	return true;
+}
+
+void Relay::disconnect() {
+	if (this->peer != nullptr) {
+		enet_peer_disconnect_now(this->peer, 0);
+		this->peer = nullptr;
+	}
+
+	this->subscribed = false;
+	this->clearState();
+}
+
+bool Relay::isSubscribed() const {
+	return this->subscribed;
+}
+
+// Returns false when the upstream connection has been lost
+bool Relay::networkEvents() {
+	ENetEvent event;
+
+	// Wait up to 10 milliseconds for an event, the downstream connection is served in between.
+	while (enet_host_service(this->connection, &event, 10) > 0) {
+		switch (event.type) {
+			case ENET_EVENT_TYPE_CONNECT: {
+				this->subscribe();
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_RECEIVE: {
+				// The passed on packets are freed by the downstream group
+				if (! this->receivePacket(event.packet)) {
+					enet_packet_destroy(event.packet);
+				}
+
+				break;
+			}
+
+			case ENET_EVENT_TYPE_DISCONNECT: {
+				std::cerr << "Lost the connection to " << net::AddressToString(this->address) << "!" << std::endl;
+
+				this->peer = nullptr;
+				this->subscribed = false;
+				this->clearState();
+
+				return false;
+			}
+
+			case ENET_EVENT_TYPE_NONE: {
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Send the copy of the game state to a joining spectator
+void Relay::sendGameState(ENetPeer *peer) const {
+	// Spectators don't get a client id
+	{
+		std::string data;
+		data += net::PACKET_HANDSHAKE;
+		data += net::NO_CLIENT;
+
+		for (auto &player : this->players) {
+			data += player.first;
+			data += static_cast<char>(player.second.length());
+			data += player.second;
+		}
+
+		net::sendCommand(peer, data.c_str(), data.length());
+	}
+
+	// Send the list of objects
+	{
+		std::string data;
+		data += net::PACKET_CREATE;
+		data += 255; // The objects are now new
+
+		for (auto &object : this->objects) {
+			net::dataAppendShort(data, object.first);
+			data += object.second.selected;
+			data += object.second.owner;
+			data += object.second.flipped;
+			data.append(object.second.location);
+			data.push_back(static_cast<char>(object.second.rotation));
+			data.push_back(static_cast<char>(object.second.fullId.size()));
+			data.append(object.second.fullId);
+		}
+
+		net::sendCommand(peer, data.c_str(), data.length());
+	}
+
+	// Send object order
+	if (! this->objectOrder.empty()) {
+		Packet reply(peer);
+		reply.writeHeader(Packet::Header::ORDER);
+		for (auto &objId : this->objectOrder) {
+			reply.writeShort(objId);
+		}
+		reply.send();
+	}
+}
+
+void Relay::subscribe() {
+	Packet packet(this->peer);
+	packet.writeHeader(Packet::Header::SUBSCRIBE);
+	packet.writeString(this->name);
+	packet.writeString(this->password);
+	packet.send();
+}
+
+// Update the copy of the game state. Returns true if the packet was passed on
+// to the spectators.
+bool Relay::receivePacket(ENetPacket *packet) {
+	if (packet->dataLength < 1) {
+		return false;
+	}
+
+	const unsigned char *data = packet->data;
+	const size_t length = packet->dataLength;
+
+	switch (static_cast<Packet::Header>(data[0])) {
+		case Packet::Header::HANDSHAKE: {
+			// The upstream server only answers to the relay itself
+			this->clearState();
+
+			size_t i = 2;
+			while (i + 2 <= length && i + 2 + data[i + 1] <= length) {
+				this->players[data[i]] = std::string(reinterpret_cast<const char*>(data + i + 2), data[i + 1]);
+				i += 2 + data[i + 1];
+			}
+
+			this->subscribed = true;
+			std::cout << "Subscribed to " << net::AddressToString(this->address) << " with "
+			          << this->players.size() << " players." << std::endl;
+
+			return false;
+		}
+
+		case Packet::Header::JOIN: {
+			if (length >= 3) {
+				this->players[data[1]] = std::string(reinterpret_cast<const char*>(data + 2), length - 2);
+			}
+
+			break;
+		}
+
+		case Packet::Header::LEAVE: {
+			if (length == 2) {
+				this->players.erase(data[1]);
+
+				// Release selected and owned objects
+				for (auto &object : this->objects) {
+					if (object.second.selected == data[1]) {
+						object.second.selected = net::NO_CLIENT;
+					}
+
+					if (object.second.owner == data[1]) {
+						object.second.owner = net::NO_CLIENT;
+					}
+				}
+			}
+
+			break;
+		}
+
+		case Packet::Header::CREATE: {
+			size_t i = 2;
+			while (i + 15 <= length && i + 15 + data[i + 14] <= length) {
+				const unsigned short objId = net::bytesToShort(packet->data + i);
+
+				if (this->objects.count(objId) == 0) {
+					this->objectOrder.push_back(objId);
+				} else {
+					this->raiseObject(objId);
+				}
+
+				ObjectRecord &object = this->objects[objId];
+				object.selected = data[i + 2];
+				object.owner = data[i + 3];
+				object.flipped = data[i + 4];
+				object.location.assign(reinterpret_cast<const char*>(data + i + 5), 8);
+				object.rotation = static_cast<char>(data[i + 13]);
+				object.fullId.assign(reinterpret_cast<const char*>(data + i + 15), data[i + 14]);
+
+				i += 15 + data[i + 14];
+			}
+
+			break;
+		}
+
+		case Packet::Header::MOVE: {
+			for (size_t i = 2; i + 10 <= length; i += 10) {
+				const unsigned short objId = net::bytesToShort(packet->data + i);
+
+				if (this->objects.count(objId) != 0) {
+					this->objects[objId].location.assign(reinterpret_cast<const char*>(data + i + 2), 8);
+					this->raiseObject(objId);
+				}
+			}
+
+			break;
+		}
+
+		case Packet::Header::SELECT: {
+			if (length >= 2) {
+				for (auto &object : this->objects) {
+					if (object.second.selected == data[1]) {
+						object.second.selected = net::NO_CLIENT;
+					}
+				}
+
+				for (size_t i = 2; i + 2 <= length; i += 2) {
+					const unsigned short objId = net::bytesToShort(packet->data + i);
+
+					if (this->objects.count(objId) != 0) {
+						this->objects[objId].selected = data[1];
+					}
+				}
+			}
+
+			break;
+		}
+
+		case Packet::Header::REMOVE: {
+			for (size_t i = 2; i + 2 <= length; i += 2) {
+				const unsigned short objId = net::bytesToShort(packet->data + i);
+
+				this->objects.erase(objId);
+				this->objectOrder.erase(std::remove(this->objectOrder.begin(), this->objectOrder.end(), objId), this->objectOrder.end());
+			}
+
+			break;
+		}
+
+		case Packet::Header::FLIP:
+		case Packet::Header::OWN: {
+			if (length >= 3) {
+				const bool flag = data[2];
+
+				for (size_t i = 3; i + 2 <= length; i += 2) {
+					const unsigned short objId = net::bytesToShort(packet->data + i);
+
+					if (this->objects.count(objId) == 0) {
+						continue;
+					}
+
+					if (data[0] == net::PACKET_FLIP) {
+						this->objects[objId].flipped = flag;
+					} else {
+						this->objects[objId].owner = flag ? data[1] : net::NO_CLIENT;
+					}
+				}
+			}
+
+			break;
+		}
+
+		case Packet::Header::ROTATE: {
+			if (length >= 4) {
+				const unsigned short objId = net::bytesToShort(packet->data + 1);
+
+				if (this->objects.count(objId) != 0) {
+					this->objects[objId].rotation += static_cast<char>(data[3]);
+				}
+			}
+
+			break;
+		}
+
+		case Packet::Header::ORDER: {
+			this->objectOrder.clear();
+
+			for (size_t i = 1; i + 2 <= length; i += 2) {
+				this->objectOrder.push_back(net::bytesToShort(packet->data + i));
+			}
+
+			break;
+		}
+
+		case Packet::Header::TIME: {
+			// The relay streams its own synchronized clock to the spectators
+			if (length >= 9) {
+				Packet time(packet);
+				time.readHeader();
+				trace::addClockSample(time.readTime(), this->peer->roundTripTime / 1000.0);
+			}
+
+			return false;
+		}
+
+		case Packet::Header::NICK_TAKEN:
+		case Packet::Header::FILE_TRANSFER: {
+			// Not meant for the spectators
+			return false;
+		}
+
+		default: {
+			break;
+		}
+	}
+
+	this->downstream->send(packet);
+	return true;
+}
+
+// Move an object to the top of the object order
+void Relay::raiseObject(unsigned short objId) {
+	this->objectOrder.erase(std::remove(this->objectOrder.begin(), this->objectOrder.end(), objId), this->objectOrder.end());
+	this->objectOrder.push_back(objId);
+}
+
+void Relay::clearState() {
+	this->players.clear();
+	this->objects.clear();
+	this->objectOrder.clear();
+}
@@ -0,0 +1,82 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <map>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include <enet/enet.h>
+
+#include "../net.h"
+#include "../packet.h"
+#include "../trace.h"
+#include "../broadcastGroup.h"
+
+// Subscribes to an upstream game server and passes its command stream on to
+// the local spectators. The relay keeps a copy of the game state so that the
+// spectators joining the relay can be synchronized without the upstream server.
+class Relay {
+public:
+	Relay(std::string host, unsigned int port, BroadcastGroup *downstream);
+	~Relay(void);
+
+	bool connect(std::string name, std::string password);
+	void disconnect(void);
+	bool isSubscribed(void) const;
+
+	bool networkEvents(void);
+	void sendGameState(ENetPeer *peer) const;
+
+private:
+	std::string host;
+	ENetAddress address;
+	ENetHost *connection;
+	ENetPeer *peer;
+
+	BroadcastGroup *downstream;
+
+	std::string name;
+	std::string password;
+	bool subscribed;
+
+	// The objects are stored in their network format, so they can be passed
+	// on as they are.
+	struct ObjectRecord {
+		unsigned char selected;
+		unsigned char owner;
+		bool flipped;
+		std::string location; // Encoded with net::dataAppendVector2()
+		int rotation;         // In steps of pi / 8
+		std::string fullId;
+	};
+
+	std::map<unsigned char, std::string> players;
+	std::map<unsigned short, ObjectRecord> objects;
+	std::vector<unsigned short> objectOrder;
+
+	void subscribe(void);
+	bool receivePacket(ENetPacket *packet);
+	void raiseObject(unsigned short objId);
+	void clearState(void);
+};
+
+#endif
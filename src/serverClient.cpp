@@ -18,13 +18,16 @@
 
 #include "serverClient.h"
 
-ServerClient::ServerClient(ENetPeer *peer, unsigned char id)
+ServerClient::ServerClient(ENetPeer *peer, unsigned short id, bool spectator)
 : Client(id),
   peer(peer),
   joined(false),
-  admin(false) {}
+  admin(false),
+  spectator(spectator),
+  receiveTime(0.0),
+  broadcastTime(0.0) {}
 
-ServerClient* ServerClient::getClientWithId(std::map<unsigned char, ServerClient*> clients, unsigned char clientId) {
+ServerClient* ServerClient::getClientWithId(const std::map<unsigned char, ServerClient*> &clients, unsigned char clientId) {
 	if (clients.count(clientId) != 0) {
 		return clients.find(clientId)->second;
 	} else {
@@ -44,6 +47,10 @@ bool ServerClient::isAdmin() const {
 	return this->admin;
 }
 
+bool ServerClient::isSpectator() const {
+	return this->spectator;
+}
+
 void ServerClient::join() {
 	this->joined = true;
 }
@@ -51,3 +58,19 @@ void ServerClient::join() {
 void ServerClient::grantAdmin() {
 	this->admin = true;
 }
+
+double ServerClient::getReceiveTime() const {
+	return this->receiveTime;
+}
+
+void ServerClient::setReceiveTime(double time) {
+	this->receiveTime = time;
+}
+
+double ServerClient::getBroadcastTime() const {
+	return this->broadcastTime;
+}
+
+void ServerClient::setBroadcastTime(double time) {
+	this->broadcastTime = time;
+}
@@ -25,21 +25,33 @@
 
 class ServerClient : public Client {
 public:
-	ServerClient(ENetPeer *peer, unsigned char id);
+	ServerClient(ENetPeer *peer, unsigned short id, bool spectator = false);
 
-	static ServerClient* getClientWithId(std::map<unsigned char, ServerClient*> clients, unsigned char clientId);
+	static ServerClient* getClientWithId(const std::map<unsigned char, ServerClient*> &clients, unsigned char clientId);
 
 	bool isJoined(void) const;
 	ENetPeer* getPeer(void) const;
 	bool isAdmin(void) const;
+	bool isSpectator(void) const;
 
 	void join(void);
 	void grantAdmin(void);
 
+	// Server time of the latest command received from the client
+	double getReceiveTime(void) const;
+	void setReceiveTime(double time);
+
+	// Server time when the latest command of the client was passed on
+	double getBroadcastTime(void) const;
+	void setBroadcastTime(double time);
+
 private:
 	ENetPeer *peer;
 	bool joined;
 	bool admin;
+	bool spectator;
+	double receiveTime;
+	double broadcastTime;
 };
 
 #endif
@@ -0,0 +1,114 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "serverQuery.h"
+
+#include <cctype>
+
+ServerQuery::ServerQuery()
+: minPlayers(0),
+  maxPlayers(65535),
+  minFreeSlots(0),
+  sort(Sort::NAME),
+  descending(false),
+  pageSize(DEFAULT_PAGE_SIZE),
+  cursor(0) {}
+
+// The default query is answered from the cache of the master server
+bool ServerQuery::isDefault() const {
+	return this->name.empty() && this->minPlayers == 0 && this->maxPlayers == 65535 && this->minFreeSlots == 0
+	       && this->packages.empty() && this->sort == Sort::NAME && ! this->descending
+	       && this->pageSize == DEFAULT_PAGE_SIZE && this->cursor == 0;
+}
+
+bool ServerQuery::matches(const std::string &lowerCaseName, unsigned short players, unsigned short slots,
+                          const std::set<std::string> &packages) const {
+	if (players < this->minPlayers || players > this->maxPlayers) {
+		return false;
+	}
+
+	if (players + this->minFreeSlots > slots) {
+		return false;
+	}
+
+	if (! this->name.empty() && lowerCaseName.find(this->name) == std::string::npos) {
+		return false;
+	}
+
+	for (auto &package : this->packages) {
+		if (packages.count(package) == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ServerQuery::write(Packet &packet) const {
+	packet.writeString(this->name);
+	packet.writeShort(this->minPlayers);
+	packet.writeShort(this->maxPlayers);
+	packet.writeShort(this->minFreeSlots);
+
+	packet.writeByte(this->packages.size());
+	for (auto &package : this->packages) {
+		packet.writeString(package);
+	}
+
+	packet.writeByte(static_cast<unsigned char>(this->sort));
+	packet.writeByte(this->descending);
+	packet.writeShort(this->pageSize);
+	packet.writeShort(this->cursor);
+}
+
+// An empty query reads as the default query
+void ServerQuery::read(Packet &packet) {
+	*this = ServerQuery();
+
+	if (packet.eof()) {
+		return;
+	}
+
+	this->name = packet.readString();
+	for (auto &character : this->name) {
+		character = std::tolower(static_cast<unsigned char>(character));
+	}
+
+	this->minPlayers = packet.readShort();
+	this->maxPlayers = packet.readShort();
+	this->minFreeSlots = packet.readShort();
+
+	unsigned char packageCount = packet.readByte();
+	for (unsigned char i = 0; i < packageCount; ++i) {
+		this->packages.push_back(packet.readString());
+	}
+
+	unsigned char sort = packet.readByte();
+	if (sort > static_cast<unsigned char>(Sort::FREE_SLOTS)) {
+		throw PacketException("Invalid sort order.");
+	}
+
+	this->sort = static_cast<Sort>(sort);
+	this->descending = packet.readByte();
+
+	this->pageSize = packet.readShort();
+	if (this->pageSize == 0 || this->pageSize > MAX_PAGE_SIZE) {
+		this->pageSize = MAX_PAGE_SIZE;
+	}
+
+	this->cursor = packet.readShort();
+}
@@ -0,0 +1,58 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SERVERQUERY_H
+#define SERVERQUERY_H
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "packet.h"
+
+// The parameters of a server list query to the master server
+class ServerQuery {
+public:
+	enum class Sort : unsigned char {NAME, PLAYERS, FREE_SLOTS};
+
+	static const unsigned short DEFAULT_PAGE_SIZE = 50;
+	static const unsigned short MAX_PAGE_SIZE     = 200;
+
+	ServerQuery(void);
+
+	// Filters
+	std::string name;                  // Substring of the server name, case insensitive
+	unsigned short minPlayers;
+	unsigned short maxPlayers;
+	unsigned short minFreeSlots;
+	std::vector<std::string> packages; // The server must have all of these
+
+	Sort sort;
+	bool descending;
+
+	unsigned short pageSize;
+	unsigned short cursor;             // Index of the first server of the page
+
+	bool isDefault(void) const;
+	bool matches(const std::string &lowerCaseName, unsigned short players, unsigned short slots,
+	             const std::set<std::string> &packages) const;
+
+	void write(Packet &packet) const;
+	void read(Packet &packet);
+};
+
+#endif
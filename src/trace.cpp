@@ -0,0 +1,179 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "trace.h"
+
+namespace {
+	std::ofstream file;
+	bool firstEvent = true;
+	unsigned int pid = 0;
+	double clockOffset = 0.0;
+	bool clockSynchronized = false;
+
+	std::string escape(const std::string &string) {
+		std::string escaped;
+
+		for (auto &character : string) {
+			if (character == '"' || character == '\\') {
+				escaped += '\\';
+				escaped += character;
+			} else if (static_cast<unsigned char>(character) < 0x20) {
+				escaped += ' ';
+			} else {
+				escaped += character;
+			}
+		}
+
+		return escaped;
+	}
+
+	void writeEvent(const std::string &event) {
+		file << (firstEvent ? "[\n" : ",\n") << event;
+		firstEvent = false;
+	}
+
+	std::string formatArguments(const trace::Arguments &arguments) {
+		std::ostringstream stream;
+		stream << std::fixed << std::setprecision(3) << "{";
+
+		for (auto argument = arguments.begin(); argument != arguments.end(); ++argument) {
+			if (argument != arguments.begin()) {
+				stream << ",";
+			}
+
+			stream << "\"" << escape(argument->first) << "\":" << argument->second;
+		}
+
+		stream << "}";
+		return stream.str();
+	}
+
+	// Trace timestamps are microseconds
+	std::string formatTimestamp(double time) {
+		std::ostringstream stream;
+		stream << std::fixed << std::setprecision(1) << (time + clockOffset) * 1000000.0;
+		return stream.str();
+	}
+}
+
+bool trace::open(std::string path, unsigned int processId, std::string processName) {
+	trace::close();
+
+	file.open(path.c_str(), std::ios::out | std::ios::trunc);
+
+	if (! file.good()) {
+		file.close();
+		return false;
+	}
+
+	firstEvent = true;
+	trace::setProcess(processId, processName);
+
+	return true;
+}
+
+void trace::close() {
+	if (file.is_open()) {
+		file << (firstEvent ? "[]\n" : "\n]\n");
+		file.close();
+	}
+}
+
+bool trace::isEnabled() {
+	return file.is_open();
+}
+
+void trace::setProcess(unsigned int processId, std::string processName) {
+	pid = processId;
+
+	if (! trace::isEnabled()) {
+		return;
+	}
+
+	writeEvent("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + utils::toString(pid)
+	           + ",\"tid\":0,\"args\":{\"name\":\"" + escape(processName) + "\"}}");
+}
+
+void trace::addClockSample(double serverTime, double roundTripTime) {
+	const double sample = serverTime + roundTripTime / 2.0 - utils::getTime();
+
+	if (clockSynchronized) {
+		clockOffset += (sample - clockOffset) * CLOCK_SMOOTHING;
+	} else {
+		clockOffset = sample;
+		clockSynchronized = true;
+	}
+}
+
+bool trace::isClockSynchronized() {
+	return clockSynchronized;
+}
+
+double trace::getClockOffset() {
+	return clockOffset;
+}
+
+double trace::getServerTime() {
+	return utils::getTime() + clockOffset;
+}
+
+void trace::complete(std::string name, std::string category, double startTime, double duration,
+                     const Arguments &arguments) {
+	if (! trace::isEnabled()) {
+		return;
+	}
+
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(1)
+	       << "{\"name\":\"" << escape(name) << "\",\"cat\":\"" << escape(category)
+	       << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":0,\"ts\":" << formatTimestamp(startTime)
+	       << ",\"dur\":" << duration * 1000000.0 << ",\"args\":" << formatArguments(arguments) << "}";
+
+	writeEvent(stream.str());
+}
+
+void trace::instant(std::string name, std::string category, const Arguments &arguments) {
+	if (! trace::isEnabled()) {
+		return;
+	}
+
+	writeEvent("{\"name\":\"" + escape(name) + "\",\"cat\":\"" + escape(category)
+	           + "\",\"ph\":\"i\",\"s\":\"p\",\"pid\":" + utils::toString(pid) + ",\"tid\":0,\"ts\":"
+	           + formatTimestamp(utils::getTime()) + ",\"args\":" + formatArguments(arguments) + "}");
+}
+
+trace::Scope::Scope(const char *name, const char *category)
+: enabled(trace::isEnabled()),
+  category(category),
+  startTime(0.0) {
+	if (this->enabled) {
+		this->name = name;
+		this->startTime = utils::getTime();
+	}
+}
+
+trace::Scope::~Scope() {
+	if (this->enabled) {
+		trace::complete(this->name, this->category, this->startTime, utils::getTime() - this->startTime, this->arguments);
+	}
+}
+
+void trace::Scope::setArgument(const char *name, double value) {
+	if (this->enabled) {
+		this->arguments[name] = value;
+	}
+}
@@ -0,0 +1,94 @@
+// Copyright 2012 Lauri Niskanen
+//
+// This file is part of OpenGamebox.
+//
+// OpenGamebox is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// OpenGamebox is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with OpenGamebox.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <map>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#include "utils.h"
+
+// Writes events in the Chrome trace event format, which can be opened in
+// chrome://tracing or Perfetto. The timestamps are in the clock of the
+// server, so the files of the server and the clients can be concatenated
+// into a single timeline. Tracing is only used from the main thread.
+namespace trace {
+	typedef std::map<std::string, double> Arguments;
+
+	bool open(std::string path, unsigned int processId, std::string processName);
+	void close(void);
+	bool isEnabled(void);
+
+	// Name the process the following events belong to
+	void setProcess(unsigned int processId, std::string processName);
+
+	// Weight of a new sample in the smoothed clock offset
+	const double CLOCK_SMOOTHING = 0.25;
+
+	// Learn the offset of the server clock from a reading of it that was
+	// sent half a round trip ago. The times are in seconds.
+	void addClockSample(double serverTime, double roundTripTime);
+	bool isClockSynchronized(void);
+	double getClockOffset(void);
+	double getServerTime(void);
+
+	// An event with a duration, the times are in local seconds
+	void complete(std::string name, std::string category, double startTime, double duration,
+	              const Arguments &arguments = Arguments());
+
+	// An event without a duration at the current time
+	void instant(std::string name, std::string category, const Arguments &arguments = Arguments());
+
+	// Adds a complete event from its construction to its destruction. While
+	// tracing is disabled nothing is built or recorded.
+	class Scope {
+	public:
+		Scope(const char *name, const char *category);
+
+		// The name is built by calling the function only if tracing is enabled
+		template <class NameFunction>
+		Scope(NameFunction getName, const char *category);
+
+		~Scope(void);
+
+		void setArgument(const char *name, double value);
+
+	private:
+		bool enabled;
+		std::string name;
+		const char *category;
+		double startTime;
+		Arguments arguments;
+	};
+}
+
+template <class NameFunction>
+trace::Scope::Scope(NameFunction getName, const char *category)
+: enabled(trace::isEnabled()),
+  category(category),
+  startTime(0.0) {
+	if (this->enabled) {
+		this->name = getName();
+		this->startTime = utils::getTime();
+	}
+}
+
+#endif
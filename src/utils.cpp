@@ -46,6 +46,11 @@ unsigned int utils::hexStringToInt(std::string string) {
 	return i;
 }
 
+// Get a monotonic timestamp in seconds for measuring short durations
+double utils::getTime() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 std::string utils::getTextFile(std::string package, std::string path){
 	PHYSFS_addToSearchPath(("data/" + package + ".zip").c_str(), 1);
 	std::string str;
@@ -76,3 +81,44 @@ std::string utils::getTextFile(std::string package, std::string path){
 
 	return str;
 }
+
+// Read the size of a png or jpg image from its header without decoding it
+bool utils::readImageSize(std::string path, Coordinates &size) {
+	PHYSFS_file *file = PHYSFS_openRead(path.c_str());
+	if (file == nullptr) {
+		return false;
+	}
+
+	unsigned char header[24];
+	bool found = false;
+
+	if (PHYSFS_read(file, header, 1, 24) == 24) {
+		if (header[0] == 0x89 && header[1] == 'P' && header[2] == 'N' && header[3] == 'G') {
+			// The IHDR chunk always comes first
+			size.x = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+			size.y = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+			found = true;
+		} else if (header[0] == 0xFF && header[1] == 0xD8) {
+			// Go through the segments until the start of the frame
+			unsigned long long position = 2;
+			unsigned char segment[9];
+
+			while (PHYSFS_seek(file, position) != 0 && PHYSFS_read(file, segment, 1, 9) == 9 && segment[0] == 0xFF) {
+				const unsigned char marker = segment[1];
+
+				if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+					size.y = (segment[5] << 8) | segment[6];
+					size.x = (segment[7] << 8) | segment[8];
+					found = true;
+					break;
+				}
+
+				position += 2 + ((segment[2] << 8) | segment[3]);
+			}
+		}
+	}
+
+	PHYSFS_close(file);
+
+	return found;
+}
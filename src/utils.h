@@ -27,6 +27,9 @@
 #include <map>
 #include <iostream>
 #include <stdexcept>
+#include <chrono>
+
+#include "coordinates.h"
 
 class IOException : public std::runtime_error {
 public:
@@ -39,18 +42,20 @@ namespace utils {
 	std::vector<std::string> splitString(std::string, char delimeter);
 	std::string toString(int i);
 	unsigned int hexStringToInt(std::string string);
+	double getTime(void);
 
 	template <class T>
-	unsigned char firstUnusedKey(std::map<unsigned char, T*> map);
+	unsigned char firstUnusedKey(const std::map<unsigned char, T*> &map);
 
 	template <class T>
-	unsigned short firstUnusedKey(std::map<unsigned short, T*> map);
+	unsigned short firstUnusedKey(const std::map<unsigned short, T*> &map);
 
 	std::string getTextFile(std::string package, std::string path);
+	bool readImageSize(std::string path, Coordinates &size);
 }
 
 template <class T>
-unsigned char utils::firstUnusedKey(std::map<unsigned char, T*> map) {
+unsigned char utils::firstUnusedKey(const std::map<unsigned char, T*> &map) {
 	for (unsigned char i = 0; i < 255; ++i) {
 		if (map.count(i) == 0) {
 			return i;
@@ -61,7 +66,7 @@ unsigned char utils::firstUnusedKey(std::map<unsigned char, T*> map) {
 }
 
 template <class T>
-unsigned short utils::firstUnusedKey(std::map<unsigned short, T*> map) {
+unsigned short utils::firstUnusedKey(const std::map<unsigned short, T*> &map) {
 	for (unsigned short i = 0; i < 65535; ++i) {
 		if (map.count(i) == 0) {
 			return i;